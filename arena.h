@@ -0,0 +1,80 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+/* ——— Bump allocator ———
+   Hands out memory from large blocks by advancing an offset; nothing is
+   freed individually.  reset() rewinds to the first block in O(1) and
+   keeps every block for reuse, so a parse (or a batch of them) that fits
+   in what the arena already holds allocates nothing at all.  Only for
+   trivially destructible types: no destructors ever run.             */
+class Arena {
+public:
+    explicit Arena(size_t blockSize = 64 * 1024) : blockSize(blockSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    // Uninitialised room for n objects of T
+    template <class T>
+    T* allocate(size_t n = 1) {
+        return static_cast<T*>(allocateBytes(n * sizeof(T), alignof(T)));
+    }
+
+    void* allocateBytes(size_t bytes, size_t align) {
+        if (current < blocks.size()) {
+            size_t p = (used + align - 1) & ~(align - 1);
+            if (p + bytes <= blocks[current].size) {
+                used = p + bytes;
+                allocated += bytes;
+                return blocks[current].data.get() + p;
+            }
+        }
+        return nextBlock(bytes, align);
+    }
+
+    void reset() {
+        current = 0;
+        used = 0;
+        allocated = 0;
+    }
+
+    size_t bytesAllocated() const { return allocated; }     // since the last reset
+    size_t bytesReserved() const {
+        size_t total = 0;
+        for (size_t i = 0; i < blocks.size(); i++) total += blocks[i].size;
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;     // new[] memory is aligned for any fundamental type
+        size_t size;
+    };
+
+    // Move on to the next kept block that is big enough, or add one
+    void* nextBlock(size_t bytes, size_t align) {
+        size_t need = bytes + align;
+        if (current < blocks.size()) current++;
+        while (current < blocks.size() && blocks[current].size < need) current++;
+        if (current == blocks.size()) {
+            size_t size = need > blockSize ? need : blockSize;
+            blocks.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+        }
+        used = 0;
+        return allocateBytes(bytes, align);
+    }
+
+    std::vector<Block> blocks;
+    size_t current = 0;                   // block being bumped
+    size_t used = 0;                      // offset into it
+    size_t allocated = 0;
+    size_t blockSize;
+};
+
+#endif   // ARENA_H
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../sourceCFG.h"
+
+// Generated from the same grammar first (see README):
+//   ./app grammar.txt input.txt out.txt --emit-parser=bench/exprParser.h
+//   ./app grammar.txt input.txt out.txt --emit-parser=bench/exprParserRd.h --emit-style=rd
+#include "exprParser.h"
+#include "exprParserRd.h"
+
+using namespace std;
+
+/* ——— Generated vs interpreted parser ———
+   Parses every line of the input `repeat` times with parseString (trace
+   level none), the generated table-driven parser and the generated
+   recursive-descent parser, checks all three agree on every line, and
+   prints lines/s and tokens/s for each.                                */
+
+template <class F>
+static double timeRuns(int repeat, F parseAll)
+{
+    auto start = chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) parseAll();
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) {
+        cerr << "Usage: " << argv[0] << " grammar.txt input.txt [repeat]\n";
+        return 1;
+    }
+    int repeat = argc > 3 ? atoi(argv[3]) : 1000;
+
+    CFGProcessor proc(argv[1], "/dev/null");
+    proc.buildTables();
+    proc.traceSink().level = TRACE_NONE;
+
+    vector<string> lines;
+    LineReader in;
+    if (!in.open(argv[2])) {
+        cerr << "Error opening input file: " << argv[2] << '\n';
+        return 1;
+    }
+    string_view line;
+    while (in.nextLine(line)) {
+        if (!line.empty()) lines.push_back(string(line));
+    }
+
+    cerr.setstate(ios::badbit);      // lexer warnings would swamp the output
+    size_t tokens = 0, mismatches = 0;
+    vector<exprParser::Token> lexed;
+    for (int i = 0; i < lines.size(); i++) {
+        exprParser::tokenize(lines[i], lexed);
+        tokens += lexed.size();
+        bool expected = proc.parseString(lines[i], i + 1);
+        if (exprParser::parse(lines[i]) != expected || exprParserRd::parse(lines[i]) != expected) {
+            cout << "Mismatch on line " << i + 1 << ": " << lines[i] << '\n';
+            mismatches++;
+        }
+    }
+
+    size_t accepted = 0;
+    double interpreted = timeRuns(repeat, [&] {
+        for (int i = 0; i < lines.size(); i++) accepted += proc.parseString(lines[i], i + 1);
+    });
+    double table = timeRuns(repeat, [&] {
+        for (int i = 0; i < lines.size(); i++) accepted += exprParser::parse(lines[i]);
+    });
+    double rd = timeRuns(repeat, [&] {
+        for (int i = 0; i < lines.size(); i++) accepted += exprParserRd::parse(lines[i]);
+    });
+    cerr.clear();
+
+    double totalLines = double(lines.size()) * repeat, totalTokens = double(tokens) * repeat;
+    auto report = [&](const string& name, double seconds) {
+        cout << left << setw(22) << name << right << fixed << setprecision(3)
+             << setw(10) << seconds << " s" << setw(14) << setprecision(0) << totalLines / seconds
+             << " lines/s" << setw(14) << totalTokens / seconds << " tokens/s"
+             << setw(8) << setprecision(2) << interpreted / seconds << "x\n";
+    };
+    cout << lines.size() << " lines, " << tokens << " tokens, x" << repeat
+         << " (" << accepted << " accepted)\n";
+    report("interpreted", interpreted);
+    report("generated (table)", table);
+    report("generated (rd)", rd);
+
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,366 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../sourceCFG.h"
+
+using namespace std;
+
+/* ——— Pipeline benchmark ———
+   Times every grammar phase (the constructor, left factoring, left
+   recursion elimination, FIRST, FOLLOW, table construction) on synthetic
+   grammars of increasing size, then getNextToken and parseString
+   throughput on synthetic inputs of increasing size.  Each case is run
+   --reps times and reported as median / p99 wall time plus the bytes the
+   phase allocated.  --json=FILE writes the same results, one object per
+   line, for comparing two builds.  Input cases are skipped when input
+   bytes x grammar levels exceeds 16G (every token descends through all
+   the levels), so 1G inputs only run on the smallest grammars.
+   --scanner pins the lexer's classification kernel, to compare them.
+   Each grammar size also times random parse-table lookups through the
+   dense and the packed table (packedTable.h), on the expression grammar
+   and on a sparse one with 128 keywords, and prints both footprints.
+
+   Usage: pipelineBench [--grammars=10,100,1000,10000]
+                        [--inputs=1K,1M,64M,1G] [--reps=N] [--json=FILE]
+                        [--scanner=avx2|sse4.2|scalar]                 */
+
+/* ——— Allocation counting ———
+   Every operator new in the process goes through here.                */
+static atomic<size_t> allocatedBytes(0);
+static atomic<size_t> allocationCount(0);
+
+static void* countedAlloc(size_t size)
+{
+    allocatedBytes.fetch_add(size, memory_order_relaxed);
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+struct Sample {
+    double seconds;
+    size_t bytes;
+    size_t allocations;
+};
+
+struct Result {
+    string bench;
+    int nonTerminals;
+    size_t inputBytes;
+    size_t items;            // tokens per run for throughput cases, else 0
+    vector<Sample> samples;
+};
+
+// Run f once and record its time and allocations
+Sample measure(const function<void()>& f)
+{
+    size_t bytes0 = allocatedBytes.load(), count0 = allocationCount.load();
+    auto start = chrono::steady_clock::now();
+    f();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return {seconds, allocatedBytes.load() - bytes0, allocationCount.load() - count0};
+}
+
+double percentile(vector<double> values, double p)
+{
+    sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(p * values.size() + 0.999999);   // nearest rank
+    return values[min(values.size(), max<size_t>(rank, 1)) - 1];
+}
+
+/* ——— Synthetic grammar with n levels of binary operators ———
+   Even levels are right-recursive with a shared prefix (work for left
+   factoring), odd levels are left-recursive (work for left recursion
+   elimination).  Operators cycle through a fixed set so the terminal
+   count, and so the table width, stays constant as n grows.            */
+const vector<string> OPERATORS = {"+", "-", "*", "/", "<", ">", "==", "!=", "<=", ">="};
+
+string syntheticGrammar(int levels)
+{
+    string g = "PROGRAM -> STMT_LIST\n"
+               "STMT_LIST -> STMT STMT_LIST | epsilon\n"
+               "STMT -> id = E0 ;\n";
+    for (int i = 0; i < levels; i++) {
+        string self = "E" + to_string(i), next = "E" + to_string(i + 1), op = OPERATORS[i % OPERATORS.size()];
+        if (i % 2 == 0) g += self + " -> " + next + " " + op + " " + self + " | " + next + "\n";
+        else            g += self + " -> " + self + " " + op + " " + next + " | " + next + "\n";
+    }
+    g += "E" + to_string(levels) + " -> id | int_lit | ( E0 )\n";
+    return g;
+}
+
+/* ——— Sparse synthetic grammar ———
+   A chain of n optional keywords, 128 of them in rotation: each chain
+   row has two filled cells out of ~130, like the statement-level rows
+   of a real language, so the dense table is mostly empty.             */
+string sparseGrammar(int levels)
+{
+    string g = "PROGRAM -> STMT_LIST\n"
+               "STMT_LIST -> STMT STMT_LIST | epsilon\n"
+               "STMT -> id = X0 ;\n";
+    for (int i = 0; i < levels; i++) {
+        g += "X" + to_string(i) + " -> kw" + to_string(i % 128) + " X" + to_string(i + 1) + " | epsilon\n";
+    }
+    g += "X" + to_string(levels) + " -> id | epsilon\n";
+    return g;
+}
+
+// A pool of statements the synthetic grammars accept, cycled to any size
+vector<string> syntheticLines(size_t count)
+{
+    mt19937 rng(42);
+    vector<string> lines;
+    for (size_t i = 0; i < count; i++) {
+        string line = "x = ";
+        int terms = 1 + rng() % 12;
+        for (int t = 0; t < terms; t++) {
+            if (t) line += " " + OPERATORS[rng() % OPERATORS.size()] + " ";
+            line += (rng() % 2) ? "y" + to_string(rng() % 100) : to_string(rng() % 1000);
+        }
+        lines.push_back(line + " ;");
+    }
+    return lines;
+}
+
+// Largest input bytes x grammar levels the parse cases will run
+const double MAX_PARSE_WORK = 16.0 * (size_t(1) << 30);
+
+size_t parseSize(const string& text)
+{
+    size_t n = strtoull(text.c_str(), nullptr, 10);
+    switch (text.empty() ? 0 : text.back()) {
+        case 'K': case 'k': return n << 10;
+        case 'M': case 'm': return n << 20;
+        case 'G': case 'g': return n << 30;
+        default:            return n;
+    }
+}
+
+template <class T>
+vector<T> parseList(const string& text, T (*convert)(const string&))
+{
+    vector<T> values;
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t comma = text.find(',', start);
+        if (comma == string::npos) comma = text.size();
+        if (comma > start) values.push_back(convert(text.substr(start, comma - start)));
+        start = comma + 1;
+    }
+    return values;
+}
+
+int toInt(const string& text) { return atoi(text.c_str()); }
+
+const size_t LOOKUPS = 1 << 22;
+
+// LOOKUPS uniformly random (non-terminal, terminal) lookups through each
+// table form of proc; prints the footprints
+void benchLookups(CFGProcessor& proc, const string& family, int nonTerminals, int reps,
+                  const function<void(const Result&)>& report)
+{
+    const SymbolTable& symbols = proc.symbols();
+    mt19937 rng(7);
+    vector<pair<Symbol, Symbol>> probes(LOOKUPS);
+    for (auto& probe : probes) {
+        probe.first = symbols.numTerminals + rng() % symbols.numNonTerminals();
+        probe.second = rng() % symbols.numTerminals;
+    }
+
+    TableFootprint auto_ = proc.tableFootprint();
+    cout << left << setw(24) << (family + " table") << right << setw(8) << nonTerminals
+         << "   dense " << auto_.denseBytes / 1024.0 << " KB, packed " << auto_.packedBytes / 1024.0
+         << " KB, auto reads " << (auto_.packed ? "packed" : "dense") << "\n";
+
+    const TableFormat formats[] = {TABLE_DENSE, TABLE_PACKED};
+    for (TableFormat format : formats) {
+        proc.setTableFormat(format);
+        Result r{family + "Lookup/" + (format == TABLE_DENSE ? "dense" : "packed"), nonTerminals, 0, LOOKUPS, {}};
+        volatile long sink = 0;
+        for (int i = 0; i < reps; i++) {
+            r.samples.push_back(measure([&] {
+                long sum = 0;
+                for (const auto& probe : probes) sum += proc.tableLookup(probe.first, probe.second);
+                sink = sink + sum;
+            }));
+        }
+        report(r);
+    }
+    proc.setTableFormat(TABLE_AUTO);
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> grammarSizes = {10, 100, 1000, 10000};
+    vector<size_t> inputSizes = {1 << 10, 1 << 20, 64 << 20, size_t(1) << 30};
+    int reps = 7;
+    string jsonPath;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--grammars=", 0) == 0) grammarSizes = parseList(arg.substr(11), toInt);
+        else if (arg.rfind("--inputs=", 0) == 0) inputSizes = parseList(arg.substr(9), parseSize);
+        else if (arg.rfind("--reps=", 0) == 0) reps = max(1, atoi(arg.c_str() + 7));
+        else if (arg.rfind("--json=", 0) == 0) jsonPath = arg.substr(7);
+        else if (arg.rfind("--scanner=", 0) == 0) {
+            if (!Lexer::useScanner(arg.substr(10))) {
+                cerr << "Scanner not available here: " << arg.substr(10) << "\n";
+                return 1;
+            }
+        }
+        else {
+            cerr << "Usage: " << argv[0] << " [--grammars=10,100,1000,10000]"
+                 << " [--inputs=1K,1M,64M,1G] [--reps=N] [--json=FILE]"
+                 << " [--scanner=avx2|sse4.2|scalar]\n";
+            return 1;
+        }
+    }
+    cout << "lexer scanner: " << Lexer::scanner() << "\n";
+
+    const string grammarPath = "pipelineBench.grammar.tmp";
+    const vector<string> pool = syntheticLines(4096);
+    const char* phases[] = {"constructor", "performLeftFactoring", "eliminateLeftRecursion",
+                            "computeFirstSets", "computeFollowSets", "constructParseTable"};
+    vector<Result> results;
+
+    cout << left << setw(24) << "bench" << right << setw(8) << "NTs" << setw(12) << "input"
+         << setw(14) << "median ms" << setw(14) << "p99 ms" << setw(14) << "MB alloc"
+         << setw(16) << "tokens/s" << "\n";
+
+    auto report = [&](const Result& r) {
+        vector<double> times;
+        for (const Sample& s : r.samples) times.push_back(s.seconds);
+        double median = percentile(times, 0.5);
+        cout << left << setw(24) << r.bench << right << setw(8) << r.nonTerminals
+             << setw(12) << r.inputBytes << fixed << setprecision(3)
+             << setw(14) << median * 1e3 << setw(14) << percentile(times, 0.99) * 1e3
+             << setw(14) << r.samples[0].bytes / 1048576.0 << setprecision(0)
+             << setw(16) << (r.items ? r.items / median : 0.0) << "\n" << flush;
+        results.push_back(r);
+    };
+
+    for (int levels : grammarSizes) {
+        {
+            ofstream g(grammarPath);
+            g << syntheticGrammar(levels);
+        }
+        const int nonTerminals = levels + 4;      // PROGRAM, STMT_LIST, STMT, E0..En
+        vector<Result> phaseResults;
+        for (const char* name : phases) phaseResults.push_back({name, nonTerminals, 0, 0, {}});
+
+        // Phases mutate the processor, so every rep starts from a fresh one
+        unique_ptr<CFGProcessor> proc;
+        for (int r = 0; r < reps; r++) {
+            proc.reset();
+            phaseResults[0].samples.push_back(measure([&] { proc.reset(new CFGProcessor(grammarPath, "/dev/null")); }));
+            proc->setReports(false);
+            phaseResults[1].samples.push_back(measure([&] { proc->performLeftFactoring(); }));
+            phaseResults[2].samples.push_back(measure([&] { proc->eliminateLeftRecursion(); }));
+            phaseResults[3].samples.push_back(measure([&] { proc->computeFirstSets(); }));
+            phaseResults[4].samples.push_back(measure([&] { proc->computeFollowSets(); }));
+            phaseResults[5].samples.push_back(measure([&] { proc->constructParseTable(); }));
+        }
+        for (const Result& r : phaseResults) report(r);
+
+        proc->traceSink().level = TRACE_NONE;
+        for (size_t size : inputSizes) {
+            // Every token walks down all the levels, so cap size x levels
+            if (double(size) * levels > MAX_PARSE_WORK) {
+                cout << left << setw(24) << "parse (skipped)" << right << setw(8) << nonTerminals
+                     << setw(12) << size << "   input too large for this grammar\n";
+                continue;
+            }
+            // Lines from the pool until the input reaches size bytes
+            size_t lines = 0, bytes = 0, tokens = 0;
+            while (bytes < size) {
+                const string& line = pool[lines % pool.size()];
+                bytes += line.size() + 1;
+                if (lines < pool.size()) {
+                    int pos = 0;
+                    while (proc->getNextToken(line, pos) != "$") tokens++;
+                    tokens++;
+                }
+                lines++;
+            }
+            // Token count of the whole input: full passes over the pool plus a prefix
+            size_t poolTokens = tokens;
+            if (lines > pool.size()) {
+                size_t full = lines / pool.size(), rest = lines % pool.size();
+                size_t restTokens = 0;
+                for (size_t i = 0; i < rest; i++) {
+                    int pos = 0;
+                    while (proc->getNextToken(pool[i], pos) != "$") restTokens++;
+                    restTokens++;
+                }
+                tokens = full * poolTokens + restTokens;
+            }
+
+            Result lex{"getNextToken", nonTerminals, bytes, tokens, {}};
+            Result parse{"parseString", nonTerminals, bytes, tokens, {}};
+            size_t accepted = 0;
+            for (int r = 0; r < reps; r++) {
+                lex.samples.push_back(measure([&] {
+                    for (size_t i = 0; i < lines; i++) {
+                        int pos = 0;
+                        while (proc->getNextToken(pool[i % pool.size()], pos) != "$") {}
+                    }
+                }));
+                parse.samples.push_back(measure([&] {
+                    for (size_t i = 0; i < lines; i++)
+                        accepted += proc->parseString(pool[i % pool.size()], static_cast<int>(i + 1));
+                }));
+            }
+            report(lex);
+            report(parse);
+            if (accepted != lines * reps)
+                cerr << "Warning: " << lines * reps - accepted << " synthetic lines were rejected\n";
+        }
+
+        benchLookups(*proc, "expr", proc->symbols().numNonTerminals(), reps, report);
+        CFGProcessor sparse;
+        if (sparse.loadGrammar(sparseGrammar(levels)) && sparse.buildTables())
+            benchLookups(sparse, "sparse", sparse.symbols().numNonTerminals(), reps, report);
+    }
+    remove(grammarPath.c_str());
+
+    if (!jsonPath.empty()) {
+        ofstream json(jsonPath);
+        json << "[\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const Result& r = results[i];
+            vector<double> times;
+            for (const Sample& s : r.samples) times.push_back(s.seconds);
+            double median = percentile(times, 0.5);
+            json << "  {\"bench\": \"" << r.bench << "\", \"nonterminals\": " << r.nonTerminals
+                 << ", \"input_bytes\": " << r.inputBytes << ", \"reps\": " << r.samples.size()
+                 << fixed << setprecision(0)
+                 << ", \"median_ns\": " << median * 1e9 << ", \"p99_ns\": " << percentile(times, 0.99) * 1e9
+                 << ", \"bytes_allocated\": " << r.samples[0].bytes
+                 << ", \"allocations\": " << r.samples[0].allocations
+                 << ", \"tokens_per_sec\": " << (r.items ? r.items / median : 0.0) << "}"
+                 << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        json << "]\n";
+    }
+    return 0;
+}
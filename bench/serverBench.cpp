@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* ——— Parse server latency ———
+   Connects --clients clients to a running `app grammar.txt --serve=SOCKET`
+   and has each keep --depth requests in flight, cycling through the
+   non-comment lines of the input, until --requests replies have come
+   back in total.  Prints requests/s and the p50 / p99 / p99.9 latency
+   from writing a request to reading its reply.
+
+   Usage: serverBench SOCKET input.txt [--clients=N] [--depth=N]
+                      [--requests=N]                                   */
+
+namespace {
+
+typedef chrono::steady_clock Clock;
+
+void putU32(string& out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) out += static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+uint32_t getU32(const char* p)
+{
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+}
+
+bool readFully(int fd, char* p, size_t n)
+{
+    while (n > 0) {
+        ssize_t got = read(fd, p, n);
+        if (got <= 0) return false;
+        p += got;  n -= got;
+    }
+    return true;
+}
+
+int connectTo(const string& path)
+{
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+    if (fd >= 0) close(fd);
+    return -1;
+}
+
+// One client: depth requests in flight, each reply's latency recorded
+bool runClient(const string& path, const vector<string>& lines, size_t requests, int depth,
+               vector<double>& latencies, size_t& accepted)
+{
+    int fd = connectTo(path);
+    if (fd < 0) return false;
+
+    vector<Clock::time_point> sentAt(requests);
+    size_t sent = 0;
+    auto send = [&]() {
+        const string& line = lines[sent % lines.size()];
+        string frame;
+        putU32(frame, static_cast<uint32_t>(line.size()));
+        putU32(frame, static_cast<uint32_t>(sent));
+        frame += line;
+        sentAt[sent++] = Clock::now();
+        return write(fd, frame.data(), frame.size()) == static_cast<ssize_t>(frame.size());
+    };
+
+    bool ok = true;
+    while (ok && sent < requests && sent < static_cast<size_t>(depth)) ok = send();
+    string text;
+    for (size_t received = 0; ok && received < requests; received++) {
+        char header[8];
+        ok = readFully(fd, header, 8);
+        if (!ok) break;
+        text.resize(getU32(header));
+        ok = readFully(fd, &text[0], text.size());
+        latencies.push_back(chrono::duration<double>(Clock::now() - sentAt[getU32(header + 4)]).count());
+        accepted += text.compare(0, 6, "accept") == 0;
+        if (ok && sent < requests) ok = send();
+    }
+    close(fd);
+    return ok;
+}
+
+double percentile(vector<double>& values, double p)
+{
+    size_t rank = min(values.size() - 1, static_cast<size_t>(p * values.size()));
+    nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    int clients = 4, depth = 8;
+    size_t requests = 200000;
+    vector<string> files;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg.rfind("--clients=", 0) == 0) clients = max(1, atoi(arg.c_str() + 10));
+        else if (arg.rfind("--depth=", 0) == 0) depth = max(1, atoi(arg.c_str() + 8));
+        else if (arg.rfind("--requests=", 0) == 0) requests = strtoull(arg.c_str() + 11, nullptr, 10);
+        else files.push_back(arg);
+    }
+    if (files.size() != 2) {
+        cerr << "Usage: " << argv[0] << " SOCKET input.txt [--clients=N] [--depth=N] [--requests=N]\n";
+        return 1;
+    }
+
+    vector<string> lines;
+    ifstream in(files[1]);
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line[0] != '#') lines.push_back(line);
+    }
+    if (lines.empty()) {
+        cerr << "No input lines in " << files[1] << "\n";
+        return 1;
+    }
+
+    vector<vector<double>> latencies(clients);
+    vector<size_t> accepted(clients, 0);
+    vector<char> ok(clients, 0);
+    vector<thread> threads;
+    auto start = Clock::now();
+    for (int c = 0; c < clients; c++) {
+        size_t share = requests / clients + (c < static_cast<int>(requests % clients));
+        threads.emplace_back([&, c, share] {
+            ok[c] = runClient(files[0], lines, share, depth, latencies[c], accepted[c]);
+        });
+    }
+    for (auto& t : threads) t.join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<double> all;
+    size_t totalAccepted = 0;
+    for (int c = 0; c < clients; c++) {
+        if (!ok[c]) {
+            cerr << "Client " << c << " lost its connection\n";
+            return 1;
+        }
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        totalAccepted += accepted[c];
+    }
+    printf("%zu requests (%zu accepted) from %d clients, %d in flight each\n",
+           all.size(), totalAccepted, clients, depth);
+    printf("%.0f requests/s   p50 %.1f us   p99 %.1f us   p99.9 %.1f us\n", all.size() / seconds,
+           percentile(all, 0.5) * 1e6, percentile(all, 0.99) * 1e6, percentile(all, 0.999) * 1e6);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/* ——— Symbols are interned into dense integer ids at load time ———
+   Terminals (including "epsilon" and "$") take ids [0, numTerminals) in
+   name order, so a terminal id doubles as its parse-table column and a
+   std::set<Symbol> of terminals iterates alphabetically.  Non-terminals
+   follow in the order they are created.  Names are for display only.   */
+typedef int Symbol;
+const Symbol NO_SYMBOL = -1;
+
+/* ——— Interned names and symbol sequences ———
+   Append-only: what is stored never moves or changes, so the pointers
+   handed out stay valid for as long as the pool lives and can be read
+   without the lock.  Each grammar has a private pool unless it is given
+   one; a GrammarRegistry gives all of its grammars the same one, so
+   they share every name and right-hand side they have in common.      */
+class GrammarPool {
+public:
+    const std::string* name(std::string_view text);
+    // The same symbols, stored once however often they are asked for
+    const Symbol* sequence(const Symbol* symbols, size_t count);
+    size_t bytes() const;                       // name characters plus sequence symbols stored
+
+private:
+    static constexpr size_t BLOCK = 4096;       // symbols per sequence block
+
+    mutable std::mutex lock;
+    std::deque<std::string> nameStore;
+    std::unordered_map<std::string_view, const std::string*> names;
+    std::vector<std::unique_ptr<Symbol[]>> blocks;
+    Symbol* next = nullptr;                     // free space at the end of the last block
+    size_t left = 0;
+    std::unordered_map<std::string_view, const Symbol*> sequences;   // keyed by the symbols' bytes
+    size_t stored = 0;
+};
+
+struct SymbolTable {
+    std::shared_ptr<GrammarPool> pool;          // where the names live; copies share it
+    std::vector<const std::string*> names;
+    std::unordered_map<std::string_view, Symbol> ids;   // views of the pooled names
+    int numTerminals = 0;
+
+    Symbol find(const std::string& name) const;
+    Symbol addTerminal(const std::string& name);      // before any non-terminal
+    Symbol addNonTerminal(const std::string& name);   // existing id if taken
+
+    int size() const { return static_cast<int>(names.size()); }
+    int numNonTerminals() const { return size() - numTerminals; }
+    bool isTerminal(Symbol s) const { return s >= 0 && s < numTerminals; }
+    bool isNonTerminal(Symbol s) const { return s >= numTerminals && s < size(); }
+    const std::string& name(Symbol s) const { return *names[s]; }
+
+private:
+    Symbol add(const std::string& name);
+};
+
+struct Grammar {
+    SymbolTable symbols;
+    // Alternatives of each non-terminal, indexed by (id - numTerminals)
+    std::vector<std::vector<std::vector<Symbol>>> productions;
+    Symbol startSymbol = NO_SYMBOL;
+    Symbol epsilon = NO_SYMBOL;
+    Symbol endMarker = NO_SYMBOL;
+
+    Symbol addNonTerminal(const std::string& name);
+    Symbol addFreshNonTerminal(const std::string& base);   // base plus enough primes to be unused
+    std::vector<std::vector<Symbol>>& rules(Symbol nt) {
+        return productions[nt - symbols.numTerminals];
+    }
+    const std::vector<std::vector<Symbol>>& rules(Symbol nt) const {
+        return productions[nt - symbols.numTerminals];
+    }
+    std::vector<Symbol> nonTerminalsByName() const;
+};
+
+#endif   // GRAMMAR_H
@@ -0,0 +1,297 @@
+#include "sourceCFG.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+/* ——— Binary cache of the processed grammar ———
+   Layout: a fixed header, then one payload holding the transformed
+   grammar (symbol table + productions), nullable flags, FIRST/FOLLOW
+   bitsets, the production arena and the dense parse table, all as
+   native-endian 32/64-bit words.
+
+   The header carries the grammar file's content hash, so an edited
+   grammar never loads a stale cache, and a hash of the payload, so a
+   truncated or damaged file is rejected instead of trusted.  Bump
+   CACHE_VERSION whenever the layout or any pipeline phase changes what
+   it produces.                                                       */
+static const char CACHE_MAGIC[4] = {'L', 'L', '1', 'C'};
+static const uint32_t CACHE_VERSION = 4;     // 4: alternatives merged up to epsilon
+
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t grammarHash;
+    uint64_t payloadSize;
+    uint64_t payloadHash;
+};
+
+// 64-bit FNV-1a, fed a word at a time where possible
+static uint64_t hashBytes(const char* p, size_t n, uint64_t h = 1469598103934665603ULL) {
+    const uint64_t prime = 1099511628211ULL;
+    while (n >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 29;
+        p += 8;
+        n -= 8;
+    }
+    while (n--) {
+        h = (h ^ static_cast<unsigned char>(*p++)) * prime;
+    }
+    return h;
+}
+
+// Content hash of the grammar file, line by line (0 if it can't be read)
+uint64_t CFGProcessor::hashGrammarFile(const string& filename) {
+    LineReader file;
+    if (!file.open(filename)) return 0;
+    uint64_t h = hashBytes(nullptr, 0);
+    string_view line;
+    while (file.nextLine(line)) {
+        h = hashBytes(line.data(), line.size(), h);
+        h = hashBytes("\n", 1, h);
+    }
+    return h;
+}
+
+namespace {
+
+class CacheWriter {
+public:
+    template <class T>
+    void put(T value) { bytes.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+
+    template <class T>
+    void putArray(const T* values, size_t n) {
+        put<uint32_t>(n);
+        if (n) bytes.append(reinterpret_cast<const char*>(values), n * sizeof(T));
+    }
+
+    string bytes;
+};
+
+// Bounds-checked reads over the mapped payload; any overrun sets ok = false
+class CacheReader {
+public:
+    CacheReader(const char* p, size_t n) : cur(p), end(p + n) {}
+
+    template <class T>
+    T get() {
+        T value{};
+        if (static_cast<size_t>(end - cur) < sizeof(T)) { ok = false; return value; }
+        memcpy(&value, cur, sizeof(T));
+        cur += sizeof(T);
+        return value;
+    }
+
+    template <class T>
+    bool getArray(vector<T>& out, size_t expected = SIZE_MAX) {
+        uint32_t n = get<uint32_t>();
+        if (!ok || (expected != SIZE_MAX && n != expected) ||
+            static_cast<size_t>(end - cur) / sizeof(T) < n) {
+            ok = false;
+            return false;
+        }
+        out.resize(n);
+        if (n) memcpy(out.data(), cur, n * sizeof(T));
+        cur += n * sizeof(T);
+        return true;
+    }
+
+    bool done() const { return ok && cur == end; }
+
+    bool ok = true;
+
+private:
+    const char* cur;
+    const char* end;
+};
+
+}
+
+bool CFGProcessor::saveCache(const string& cachePath) {
+    PhaseTimer timer(metrics, "saveCache");
+    if (!grammarHash) grammarHash = hashGrammarFile(grammarFile);
+    const SymbolTable& sym = grammar.symbols;
+    CacheWriter w;
+
+    w.put<int32_t>(sym.numTerminals);
+    w.put<int32_t>(sym.size());
+    w.put<int32_t>(grammar.startSymbol);
+    w.put<int32_t>(grammar.epsilon);
+    w.put<int32_t>(grammar.endMarker);
+    for (Symbol s = 0; s < sym.size(); s++) {
+        w.putArray(sym.name(s).data(), sym.name(s).size());
+    }
+
+    for (int nt = 0; nt < sym.numNonTerminals(); nt++) {
+        const vector<vector<Symbol>>& rules = grammar.productions[nt];
+        w.put<uint32_t>(rules.size());
+        for (int i = 0; i < rules.size(); i++) {
+            w.putArray(rules[i].data(), rules[i].size());
+        }
+    }
+
+    vector<char> flags(nullable.begin(), nullable.end());
+    w.putArray(flags.data(), flags.size());
+    for (int nt = 0; nt < sym.numNonTerminals(); nt++) {
+        w.putArray(firstSets[nt].raw().data(), firstSets[nt].raw().size());
+        w.putArray(followSets[nt].raw().data(), followSets[nt].raw().size());
+    }
+
+    w.putArray(productionArena.data(), productionArena.size());
+    w.putArray(rhsArena.data(), rhsArena.size());
+    w.putArray(parseTable.data(), parseTable.size());
+    w.putArray(conflicts.data(), conflicts.size());
+
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, 4);
+    header.version = CACHE_VERSION;
+    header.grammarHash = grammarHash;
+    header.payloadSize = w.bytes.size();
+    header.payloadHash = hashBytes(w.bytes.data(), w.bytes.size());
+
+    // Write beside the target and rename, so readers never see half a file
+    string tmp = cachePath + ".tmp";
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&header, sizeof header, 1, f) == 1 &&
+              fwrite(w.bytes.data(), 1, w.bytes.size(), f) == w.bytes.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), cachePath.c_str()) != 0) {
+        remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CFGProcessor::loadCache(const string& cachePath) {
+    PhaseTimer timer(metrics, "loadCache");
+    CachedAnalysis cached;
+    if (!readCache(cachePath, true, cached)) return false;
+
+    grammar = move(cached.grammar);
+    nullable = move(cached.nullable);
+    firstSets = move(cached.firstSets);
+    followSets = move(cached.followSets);
+    productionArena = move(cached.productionArena);
+    rhsArena = move(cached.rhsArena);
+    parseTable = move(cached.parseTable);
+    conflicts = move(cached.conflicts);
+    buildDriverTables();
+    lexer = Lexer(grammar);
+    return true;
+}
+
+// Map and validate a cache file.  With requireFresh it must also have been
+// built from the current grammar text; without, any intact cache will do.
+bool CFGProcessor::readCache(const string& cachePath, bool requireFresh, CachedAnalysis& out) {
+    if (!grammarHash) grammarHash = hashGrammarFile(grammarFile);
+    int fd = open(cachePath.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CacheHeader))) {
+        close(fd);
+        return false;
+    }
+    size_t size = st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const char* base = static_cast<const char*>(map);
+    CacheHeader header;
+    memcpy(&header, base, sizeof header);
+    const char* payload = base + sizeof header;
+
+    bool ok = memcmp(header.magic, CACHE_MAGIC, 4) == 0 &&
+              header.version == CACHE_VERSION &&
+              (!requireFresh || header.grammarHash == grammarHash) &&
+              header.payloadSize == size - sizeof header &&
+              header.payloadHash == hashBytes(payload, header.payloadSize);
+
+    Grammar g;
+    vector<char> flags;
+    vector<TerminalSet> first, follow;
+    vector<Production> arena;
+    vector<Symbol> rhs;
+    vector<int> table;
+    vector<TableConflict> clashes;
+
+    if (ok) {
+        CacheReader r(payload, header.payloadSize);
+        int numTerminals = r.get<int32_t>();
+        int numSymbols = r.get<int32_t>();
+        g.startSymbol = r.get<int32_t>();
+        g.epsilon = r.get<int32_t>();
+        g.endMarker = r.get<int32_t>();
+        ok = r.ok && 0 < numTerminals && numTerminals <= numSymbols;
+
+        vector<char> name;
+        for (Symbol s = 0; ok && s < numSymbols; s++) {
+            ok = r.getArray(name);
+            string text(name.begin(), name.end());
+            Symbol id = (s < numTerminals) ? g.symbols.addTerminal(text) : g.addNonTerminal(text);
+            ok = ok && id == s;
+        }
+        auto valid = [&](Symbol s) { return s >= 0 && s < numSymbols; };
+        ok = ok && valid(g.startSymbol) && valid(g.epsilon) && valid(g.endMarker);
+
+        const int count = numSymbols - numTerminals;
+        const size_t words = (numTerminals + 63) / 64;
+        for (int nt = 0; ok && nt < count; nt++) {
+            uint32_t alternatives = r.get<uint32_t>();
+            g.productions[nt].resize(alternatives);
+            for (uint32_t i = 0; r.ok && i < alternatives; i++) {
+                r.getArray(g.productions[nt][i]);
+                for (Symbol s : g.productions[nt][i]) ok = ok && valid(s);
+            }
+            ok = ok && r.ok;
+        }
+
+        ok = ok && r.getArray(flags, count);
+        first.assign(count, TerminalSet(numTerminals));
+        follow.assign(count, TerminalSet(numTerminals));
+        for (int nt = 0; ok && nt < count; nt++) {
+            ok = r.getArray(first[nt].raw(), words) && r.getArray(follow[nt].raw(), words);
+        }
+
+        ok = ok && r.getArray(arena) && r.getArray(rhs) &&
+             r.getArray(table, static_cast<size_t>(count) * numTerminals) &&
+             r.getArray(clashes) && r.done();
+        // buildDriverTables indexes by lhs - numTerminals and expects each
+        // non-terminal's productions to be one run of the arena
+        auto nonTerminal = [&](Symbol s) { return s >= numTerminals && s < numSymbols; };
+        for (int i = 0; i < arena.size(); i++) {
+            const Production& p = arena[i];
+            ok = ok && nonTerminal(p.lhs) && (i == 0 || arena[i - 1].lhs <= p.lhs) &&
+                 p.start >= 0 && p.length >= 0 && static_cast<size_t>(p.start) + p.length <= rhs.size();
+        }
+        for (Symbol s : rhs) ok = ok && valid(s);
+        for (int cell : table) ok = ok && cell >= NO_PRODUCTION && cell < static_cast<int>(arena.size());
+        for (const TableConflict& c : clashes) {
+            ok = ok && nonTerminal(c.nonTerminal) && c.terminal >= 0 && c.terminal < numTerminals &&
+                 c.kept >= 0 && c.kept < static_cast<int>(arena.size()) &&
+                 c.dropped >= 0 && c.dropped < static_cast<int>(arena.size());
+        }
+    }
+    munmap(map, size);
+    if (!ok) return false;
+
+    out.grammar = move(g);
+    out.nullable.assign(flags.begin(), flags.end());
+    out.firstSets = move(first);
+    out.followSets = move(follow);
+    out.productionArena = move(arena);
+    out.rhsArena = move(rhs);
+    out.parseTable = move(table);
+    out.conflicts = move(clashes);
+    return true;
+}
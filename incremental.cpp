@@ -0,0 +1,254 @@
+#include "sourceCFG.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+/* ——— Incremental re-analysis ———
+   When the cache is intact but was built from an older grammar text, the
+   new grammar is transformed as usual and then diffed, non-terminal by
+   non-terminal, against the cached (transformed) grammar.  Only what the
+   changed productions can reach is recomputed:
+
+     nullable/FIRST  the changed non-terminals and everything that
+                     mentions them, transitively;
+     FOLLOW          non-terminals that occur in a changed (old or new)
+                     production or in one whose FIRST/nullable changed,
+                     plus whatever their FOLLOW flows into;
+     table rows      changed non-terminals and those whose FIRST-of-RHS
+                     or FOLLOW changed.
+
+   Everything else is copied from the cache with ids translated by name,
+   so the result is identical to a full rebuild.  A change to the set of
+   terminals (the table's columns) falls back to the full pipeline.    */
+
+bool CFGProcessor::reanalyze(const string& cachePath)
+{
+    PhaseTimer timer(metrics, "reanalyze");
+    CachedAnalysis old;
+    if (!readCache(cachePath, false, old)) return false;
+
+    const bool wasReporting = reports;
+    reports = false;
+    performLeftFactoring();
+    if (!eliminateLeftRecursion()) {
+        reports = wasReporting;
+        return false;
+    }
+
+    const SymbolTable& sym = grammar.symbols;
+    const SymbolTable& oldSym = old.grammar.symbols;
+    const int base = sym.numTerminals;
+    const int count = sym.numNonTerminals();
+
+    bool sameTerminals = oldSym.numTerminals == base;
+    for (Symbol t = 0; sameTerminals && t < base; t++) {
+        sameTerminals = oldSym.name(t) == sym.name(t);
+    }
+    if (!sameTerminals) {
+        computeFirstSets();
+        computeFollowSets();
+        constructParseTable();
+        lexer = Lexer(grammar);
+        reports = wasReporting;
+        return true;
+    }
+
+    // Non-terminals correspond by name
+    vector<Symbol> oldOf(count, NO_SYMBOL);          // new index -> old id
+    vector<Symbol> newOf(oldSym.numNonTerminals(), NO_SYMBOL);
+    for (Symbol nt = base; nt < sym.size(); nt++) {
+        Symbol o = oldSym.find(sym.name(nt));
+        if (oldSym.isNonTerminal(o)) {
+            oldOf[nt - base] = o;
+            newOf[o - base] = nt;
+        }
+    }
+    auto translate = [&](Symbol o) { return oldSym.isTerminal(o) ? o : newOf[o - base]; };
+
+    // Who mentions whom, in the new grammar
+    vector<vector<Symbol>> users(count);
+    for (Symbol nt = base; nt < sym.size(); nt++) {
+        const vector<vector<Symbol>>& rules = grammar.rules(nt);
+        for (int i = 0; i < rules.size(); i++) {
+            for (int j = 0; j < rules[i].size(); j++) {
+                Symbol s = rules[i][j];
+                if (isNonTerminal(s) && (users[s - base].empty() || users[s - base].back() != nt)) {
+                    users[s - base].push_back(nt);
+                }
+            }
+        }
+    }
+
+    // Non-terminals whose productions differ (or that are new)
+    vector<bool> changed(count, false);
+    for (Symbol nt = base; nt < sym.size(); nt++) {
+        Symbol o = oldOf[nt - base];
+        if (o == NO_SYMBOL) {
+            changed[nt - base] = true;
+            continue;
+        }
+        const vector<vector<Symbol>>& rules = grammar.rules(nt);
+        const vector<vector<Symbol>>& oldRules = old.grammar.rules(o);
+        bool same = rules.size() == oldRules.size();
+        for (int i = 0; same && i < rules.size(); i++) {
+            same = rules[i].size() == oldRules[i].size();
+            for (int j = 0; same && j < rules[i].size(); j++) {
+                same = translate(oldRules[i][j]) == rules[i][j];
+            }
+        }
+        changed[nt - base] = !same;
+    }
+
+    // Close a seed set over an edge list
+    auto closeOver = [&](vector<bool>& set, const vector<vector<Symbol>>& edges) {
+        vector<Symbol> worklist;
+        for (int i = 0; i < count; i++) {
+            if (set[i]) worklist.push_back(base + i);
+        }
+        while (!worklist.empty()) {
+            Symbol nt = worklist.back();
+            worklist.pop_back();
+            const vector<Symbol>& next = edges[nt - base];
+            for (int i = 0; i < next.size(); i++) {
+                if (!set[next[i] - base]) {
+                    set[next[i] - base] = true;
+                    worklist.push_back(next[i]);
+                }
+            }
+        }
+    };
+
+    // Start from the cached sets, translated to the new ids
+    nullable.assign(count, false);
+    firstSets.assign(count, TerminalSet(base));
+    followSets.assign(count, TerminalSet(base));
+    for (int i = 0; i < count; i++) {
+        Symbol o = oldOf[i];
+        if (o == NO_SYMBOL) continue;
+        nullable[i] = old.nullable[o - base];
+        firstSets[i] = old.firstSets[o - base];
+        followSets[i] = old.followSets[o - base];
+    }
+
+    /* —— nullable and FIRST —— */
+    vector<bool> firstCone = changed;
+    closeOver(firstCone, users);
+    computeNullable(&firstCone);
+    propagateFirst(&firstCone);
+
+    vector<bool> firstChanged(count, false);
+    for (int i = 0; i < count; i++) {
+        Symbol o = oldOf[i];
+        firstChanged[i] = firstCone[i] &&
+            (o == NO_SYMBOL || nullable[i] != old.nullable[o - base] || firstSets[i] != old.firstSets[o - base]);
+    }
+
+    /* —— FOLLOW —— */
+    vector<bool> followCone(count, false);
+    auto markSymbols = [&](const vector<vector<Symbol>>& rules, bool oldIds) {
+        for (int i = 0; i < rules.size(); i++) {
+            for (int j = 0; j < rules[i].size(); j++) {
+                Symbol s = oldIds ? translate(rules[i][j]) : rules[i][j];
+                if (s != NO_SYMBOL && isNonTerminal(s)) followCone[s - base] = true;
+            }
+        }
+    };
+    for (Symbol nt = base; nt < sym.size(); nt++) {
+        if (changed[nt - base]) {
+            markSymbols(grammar.rules(nt), false);
+            if (oldOf[nt - base] != NO_SYMBOL) markSymbols(old.grammar.rules(oldOf[nt - base]), true);
+        }
+        if (firstChanged[nt - base]) {
+            for (int u = 0; u < users[nt - base].size(); u++) markSymbols(grammar.rules(users[nt - base][u]), false);
+        }
+    }
+    for (Symbol o = oldSym.numTerminals; o < oldSym.size(); o++) {
+        if (newOf[o - base] == NO_SYMBOL) markSymbols(old.grammar.rules(o), true);   // removed
+    }
+    if (old.grammar.startSymbol != NO_SYMBOL && translate(old.grammar.startSymbol) != grammar.startSymbol) {
+        followCone[grammar.startSymbol - base] = true;
+        if (translate(old.grammar.startSymbol) != NO_SYMBOL) followCone[translate(old.grammar.startSymbol) - base] = true;
+    }
+
+    // FOLLOW(A) reaches X when X ends one of A's productions, up to a nullable tail
+    vector<vector<Symbol>> tails(count);
+    for (Symbol nt = base; nt < sym.size(); nt++) {
+        const vector<vector<Symbol>>& rules = grammar.rules(nt);
+        for (int i = 0; i < rules.size(); i++) {
+            for (int j = static_cast<int>(rules[i].size()) - 1; j >= 0; j--) {
+                Symbol X = rules[i][j];
+                if (X == grammar.epsilon) continue;
+                if (isTerminal(X)) break;
+                if (X != nt) tails[nt - base].push_back(X);
+                if (!isNullable(X)) break;
+            }
+        }
+    }
+    closeOver(followCone, tails);
+
+    vector<Symbol> scan;
+    vector<bool> scanned(count, false);
+    for (int i = 0; i < count; i++) {
+        if (!followCone[i]) continue;
+        for (int u = 0; u < users[i].size(); u++) {
+            if (!scanned[users[i][u] - base]) {
+                scanned[users[i][u] - base] = true;
+                scan.push_back(users[i][u]);
+            }
+        }
+    }
+    sort(scan.begin(), scan.end());
+    propagateFollow(&followCone, &scan);
+
+    /* —— table rows —— */
+    vector<bool> rebuild = changed;
+    for (int i = 0; i < count; i++) {
+        Symbol o = oldOf[i];
+        if (followCone[i] && (o == NO_SYMBOL || followSets[i] != old.followSets[o - base])) rebuild[i] = true;
+        if (firstChanged[i]) {
+            for (int u = 0; u < users[i].size(); u++) rebuild[users[i][u] - base] = true;
+        }
+    }
+
+    // First arena index of each old non-terminal's productions, and its conflicts
+    vector<int> oldFirst(oldSym.numNonTerminals(), -1);
+    for (int p = static_cast<int>(old.productionArena.size()) - 1; p >= 0; p--) {
+        oldFirst[old.productionArena[p].lhs - base] = p;
+    }
+    vector<vector<TableConflict>> oldConflicts(oldSym.numNonTerminals());
+    for (int i = 0; i < old.conflicts.size(); i++) {
+        oldConflicts[old.conflicts[i].nonTerminal - base].push_back(old.conflicts[i]);
+    }
+
+    productionArena.clear();
+    rhsArena.clear();
+    conflicts.clear();
+    parseTable.assign(count * base, NO_PRODUCTION);
+    vector<bool> predictedByFirst;
+    for (Symbol nt = base; nt < sym.size(); nt++) {
+        int first = appendProductions(nt);
+        if (rebuild[nt - base]) {
+            fillTableRow(nt, first, predictedByFirst, conflicts);
+            continue;
+        }
+
+        // Unchanged productions: same cells, shifted to the new arena indices
+        Symbol o = oldOf[nt - base];
+        const int shift = first - oldFirst[o - base];
+        const int* row = &old.parseTable[(o - base) * base];
+        for (Symbol t = 0; t < base; t++) {
+            if (row[t] != NO_PRODUCTION) tableCell(nt, t) = row[t] + shift;
+        }
+        const vector<TableConflict>& clashes = oldConflicts[o - base];
+        for (int i = 0; i < clashes.size(); i++) {
+            conflicts.push_back({nt, clashes[i].terminal, clashes[i].kept + shift, clashes[i].dropped + shift});
+        }
+    }
+
+    buildDriverTables();
+    lexer = Lexer(grammar);
+    reports = wasReporting;
+    return true;
+}
@@ -0,0 +1,295 @@
+#include "lexer.h"
+
+#include <algorithm>
+#include <ostream>
+
+#if LL1_SIMD && (defined(__x86_64__) || defined(__i386__))
+#define LL1_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Character classes, as isspace/isalnum/isdigit see them in the C locale
+enum : uint8_t { SPACE = 1, WORD = 2, DIGIT = 4, WORD_START = 8, SINGLE = 16 };
+
+struct ClassTable {
+    uint8_t of[256] = {};
+    ClassTable() {
+        for (int c = 0; c < 256; c++) {
+            bool alpha = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+            bool digit = c >= '0' && c <= '9';
+            if (c == ' ' || (c >= '\t' && c <= '\r')) of[c] |= SPACE;
+            if (alpha || digit || c == '_') of[c] |= WORD;
+            if (digit) of[c] |= DIGIT;
+            if (alpha || c == '_') of[c] |= WORD_START;
+        }
+        // Single-char punctuation and standalone < or >
+        for (const char* p = "(){}`;=+-*/<>"; *p; p++) of[static_cast<unsigned char>(*p)] |= SINGLE;
+    }
+};
+const ClassTable classes;
+
+// One table lookup per byte
+struct ScalarRuns {
+    string_view text;
+
+    // First position from pos on whose byte is not in cls
+    size_t end(size_t pos, uint8_t cls) const {
+        while (pos < text.size() && (classes.of[static_cast<unsigned char>(text[pos])] & cls)) pos++;
+        return pos;
+    }
+};
+
+// Class bitmasks of one 64-byte block: bit i is byte i
+struct BlockMasks {
+    uint64_t space, word, digit;
+};
+typedef void (*ClassifyFn)(const char* block, BlockMasks& out);
+
+#if LL1_SIMD_X86
+// Four 16-byte compares against character ranges; PCMPESTRM hands back
+// the matches as a bitmask directly
+__attribute__((target("sse4.2")))
+void classifySse42(const char* block, BlockMasks& out) {
+    constexpr int MODE = _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES | _SIDD_BIT_MASK;
+    const __m128i spaces = _mm_setr_epi8('\t', '\r', ' ', ' ', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i words = _mm_setr_epi8('0', '9', 'A', 'Z', '_', '_', 'a', 'z', 0, 0, 0, 0, 0, 0, 0, 0);
+    out = {0, 0, 0};
+    for (int i = 0; i < 4; i++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        out.space |= static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_cmpestrm(spaces, 4, v, 16, MODE)) & 0xffff) << (16 * i);
+        out.word |= static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_cmpestrm(words, 8, v, 16, MODE)) & 0xffff) << (16 * i);
+        // the first range of words on its own is the digits
+        out.digit |= static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_cmpestrm(words, 2, v, 16, MODE)) & 0xffff) << (16 * i);
+    }
+}
+
+// lo <= v <= hi, bytewise and unsigned
+__attribute__((target("avx2")))
+inline __m256i inRange(__m256i v, char lo, char hi) {
+    __m256i aboveLo = _mm256_cmpeq_epi8(_mm256_max_epu8(v, _mm256_set1_epi8(lo)), v);
+    __m256i belowHi = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(hi)), v);
+    return _mm256_and_si256(aboveLo, belowHi);
+}
+
+// Two 32-byte halves; letters are folded to lower case with | 0x20
+__attribute__((target("avx2")))
+void classifyAvx2(const char* block, BlockMasks& out) {
+    out = {0, 0, 0};
+    for (int i = 0; i < 2; i++) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        __m256i digit = inRange(v, '0', '9');
+        __m256i alpha = inRange(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i word = _mm256_or_si256(_mm256_or_si256(alpha, digit), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+        __m256i space = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), inRange(v, '\t', '\r'));
+        out.space |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(space))) << (32 * i);
+        out.word |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(word))) << (32 * i);
+        out.digit |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(digit))) << (32 * i);
+    }
+}
+#endif
+
+struct Scanner {
+    const char* name;
+    ClassifyFn classify;            // nullptr: scalar
+};
+
+const Scanner scanners[] = {
+#if LL1_SIMD_X86
+    {"avx2", classifyAvx2},
+    {"sse4.2", classifySse42},
+#endif
+    {"scalar", nullptr},
+};
+
+bool supported(const Scanner& s) {
+#if LL1_SIMD_X86
+    __builtin_cpu_init();
+    if (s.classify == classifyAvx2) return __builtin_cpu_supports("avx2");
+    if (s.classify == classifySse42) return __builtin_cpu_supports("sse4.2");
+#endif
+    return s.classify == nullptr;
+}
+
+// The best kernel this CPU runs
+const Scanner* pickScanner() {
+    for (const Scanner& s : scanners) {
+        if (supported(s)) return &s;
+    }
+    return nullptr;
+}
+const Scanner* active = pickScanner();
+
+// Whole 64-byte blocks are classified once and scanned with ctz; the
+// block the text doesn't fill goes byte by byte, so nothing past the
+// end of the text is ever read.
+struct BlockRuns {
+    string_view text;
+    ClassifyFn classify;
+    size_t block = SIZE_MAX;        // index of the block in masks
+    BlockMasks masks = {0, 0, 0};
+
+    size_t end(size_t pos, uint8_t cls) {
+        while (pos < text.size()) {
+            size_t b = pos / 64;
+            if (b * 64 + 64 > text.size()) return ScalarRuns{text}.end(pos, cls);
+            if (b != block) {
+                classify(text.data() + b * 64, masks);
+                block = b;
+            }
+            uint64_t in = cls == SPACE ? masks.space : cls == WORD ? masks.word : masks.digit;
+            uint64_t stop = ~in >> (pos % 64);
+            if (stop) return pos + __builtin_ctzll(stop);
+            pos = b * 64 + 64;
+        }
+        return pos;
+    }
+};
+
+// Multiplicative hash; its top bits pick the slot
+uint32_t hashWord(string_view word) {
+    uint32_t h = static_cast<uint32_t>(word.size());
+    for (size_t i = 0; i < word.size(); i++) h = h * 31 + static_cast<unsigned char>(word[i]);
+    return h * 0x9E3779B1u;
+}
+
+}   // namespace
+
+
+// Index every terminal name for lookups by string_view.  The names stay
+// in the symbol table's pool, which never moves them, even as the table
+// grows later (transformations keep adding non-terminals).
+Lexer::Lexer(const Grammar& g) {
+    const SymbolTable& table = g.symbols;
+
+    pool = table.pool;
+    for (Symbol t = 0; t < table.numTerminals; t++) {
+        names.push_back(string_view(table.name(t)));
+        longestName = max(longestName, names.back().size());
+    }
+
+    // Keyword lookups run once per word, so they get a flat table at
+    // most half full instead of a node-based map
+    int bits = 1;
+    while ((size_t(1) << bits) < 2 * names.size()) bits++;
+    slotShift = 32 - bits;
+    slots.assign(size_t(1) << bits, NO_SYMBOL);
+    for (Symbol t = 0; t < names.size(); t++) {
+        size_t i = hashWord(names[t]) >> slotShift;
+        while (slots[i] != NO_SYMBOL) i = (i + 1) & (slots.size() - 1);
+        slots[i] = t;
+    }
+
+    for (int c = 0; c < 256; c++) {
+        char one = static_cast<char>(c);
+        charTerminal[c] = lookup(string_view(&one, 1));
+    }
+    idTerminal = lookup("id");
+    intLiteral = lookup("int_lit");
+    endMarker = g.endMarker;
+}
+
+Symbol Lexer::lookup(string_view word) const {
+    if (slots.empty() || word.size() > longestName) return NO_SYMBOL;
+    for (size_t i = hashWord(word) >> slotShift; slots[i] != NO_SYMBOL; i = (i + 1) & (slots.size() - 1)) {
+        if (names[slots[i]] == word) return slots[i];
+    }
+    return NO_SYMBOL;
+}
+
+// One token from pos on; runs finds where whitespace, words and numbers end
+template <class Runs>
+Token Lexer::scan(string_view text, size_t& pos, Runs& runs, ostream& diag) const {
+    pos = runs.end(pos, SPACE);
+
+    if (pos >= text.size()) {
+        return {endMarker, static_cast<uint32_t>(pos), 0};
+    }
+
+    const uint32_t start = pos;
+    const unsigned char c = text[pos];
+
+    // Two-char operators (checked before single '=' so "==" stays whole)
+    if ((c == '=' || c == '!' || c == '<' || c == '>') &&
+        pos + 1 < text.size() && text[pos + 1] == '=') {
+        pos += 2;
+        return {lookup(text.substr(start, 2)), start, 2};
+    }
+
+    if (classes.of[c] & SINGLE) {
+        ++pos;
+        return {charTerminal[c], start, 1};
+    }
+
+    // Identifiers / keywords: a terminal with the same spelling is a
+    // keyword, anything else is an "id".  "int" and "if" are always kept
+    // as themselves.
+    if (classes.of[c] & WORD_START) {
+        pos = runs.end(pos + 1, WORD);
+        string_view word = text.substr(start, pos - start);
+        Symbol keyword = lookup(word);
+        if (keyword == NO_SYMBOL && word != "int" && word != "if") {
+            keyword = idTerminal;
+        }
+        return {keyword, start, static_cast<uint32_t>(pos - start)};
+    }
+
+    // Integer literals
+    if (classes.of[c] & DIGIT) {
+        pos = runs.end(pos + 1, DIGIT);
+        return {intLiteral, start, static_cast<uint32_t>(pos - start)};
+    }
+
+    // Unknown char
+    ++pos;
+    diag << "Warning: unrecognised char '" << static_cast<char>(c) << "'\n";
+    return {charTerminal[c], start, 1};
+}
+
+Token Lexer::next(string_view text, size_t& pos, ostream& diag) const {
+    ScalarRuns runs{text};
+    return scan(text, pos, runs, diag);
+}
+
+void Lexer::tokenize(string_view text, vector<Token>& out, ostream& diag) const {
+    out.clear();
+    size_t pos = 0;
+    auto lexAll = [&](auto& runs) {
+        while (true) {
+            Token tok = scan(text, pos, runs, diag);
+            out.push_back(tok);
+            if (tok.length == 0) break;
+        }
+    };
+    if (active->classify && text.size() >= 64) {
+        BlockRuns runs{text, active->classify};
+        lexAll(runs);
+    } else {
+        ScalarRuns runs{text};
+        lexAll(runs);
+    }
+}
+
+string_view Lexer::text(const Token& tok, string_view source) const {
+    if (tok.terminal != NO_SYMBOL) {
+        return names[tok.terminal];
+    }
+    return source.substr(tok.offset, tok.length);
+}
+
+const char* Lexer::scanner() {
+    return active->name;
+}
+
+bool Lexer::useScanner(string_view name) {
+    for (const Scanner& s : scanners) {
+        if (name == s.name && supported(s)) {
+            active = &s;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,79 @@
+#ifndef LEXER_H
+#define LEXER_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "grammar.h"
+
+/* ——— Vectorised scanning ———
+   tokenize() classifies the text 64 bytes at a time into whitespace /
+   word / digit bitmasks and finds token ends with bit scans.  The
+   kernel (AVX2, SSE4.2 or plain C++) is picked once at startup from
+   what the CPU supports; a block the text doesn't fill, and next(), use
+   the scalar path.  Build with -DLL1_SIMD=0 to leave only that.       */
+#ifndef LL1_SIMD
+#define LL1_SIMD 1
+#endif
+
+/* ——— One lexed token ———
+   Points back into the source text instead of owning its lexeme, so a
+   whole line or file lexes into one flat array with no per-token
+   allocation.  offset is also the token's exact column (0-based).     */
+struct Token {
+    Symbol terminal;     // NO_SYMBOL if the grammar has no matching terminal
+    uint32_t offset;
+    uint32_t length;
+};
+
+class Lexer {
+public:
+    Lexer() {}
+    explicit Lexer(const Grammar& g);
+
+    // Views point into pool, which a move keeps but a copy would not
+    Lexer(const Lexer&) = delete;
+    Lexer& operator=(const Lexer&) = delete;
+    Lexer(Lexer&&) = default;
+    Lexer& operator=(Lexer&&) = default;
+
+    // Scan one token starting at pos (skipping whitespace) and advance pos.
+    // At the end of text this returns the end marker with length 0.
+    // Unrecognised characters are reported on diag.
+    Token next(std::string_view text, size_t& pos, std::ostream& diag) const;
+
+    // Lex a whole line/file into out (cleared first); the last token is
+    // always the end marker.
+    void tokenize(std::string_view text, std::vector<Token>& out, std::ostream& diag) const;
+
+    // What the trace shows for a token: the terminal name, or the raw
+    // lexeme when the grammar has no terminal for it
+    std::string_view text(const Token& tok, std::string_view source) const;
+
+    // The classification kernel in use: "avx2", "sse4.2" or "scalar".
+    // useScanner pins one (false if this CPU or build lacks it); call it
+    // before lexing starts, as the choice is shared by every thread.
+    static const char* scanner();
+    static bool useScanner(std::string_view name);
+
+private:
+    Symbol lookup(std::string_view word) const;
+    template <class Runs>
+    Token scan(std::string_view text, size_t& pos, Runs& runs, std::ostream& diag) const;
+
+    std::shared_ptr<GrammarPool> pool;                  // holds the terminal names the views below point at
+    std::vector<std::string_view> names;                // by terminal id
+    std::vector<Symbol> slots;                          // open-addressed terminal ids by name hash
+    int slotShift = 32;                                 // slot = hash >> slotShift
+    size_t longestName = 0;                             // longer words can't be terminals
+    Symbol charTerminal[256];                           // one-character terminals
+    Symbol idTerminal = NO_SYMBOL;
+    Symbol intLiteral = NO_SYMBOL;
+    Symbol endMarker = NO_SYMBOL;
+};
+
+#endif   // LEXER_H
@@ -0,0 +1,139 @@
+#include "lineReader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+static const size_t READ_CHUNK = 1 << 20;
+static const size_t RELEASE_STEP = 64 << 20;
+
+bool LineReader::open(const string& path) {
+    close();
+
+    if (path == "-") {
+        fd = STDIN_FILENO;
+        ownsFd = false;
+    } else {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        ownsFd = true;
+    }
+
+    // Map regular files; an empty file has nothing to map
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        size = st.st_size;
+        if (size == 0) {
+            mapped = true;
+            return true;
+        }
+        void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            madvise(p, size, MADV_SEQUENTIAL);
+            data = static_cast<const char*>(p);
+            mapped = ownsMap = true;
+            return true;
+        }
+        size = 0;
+    }
+
+    // Pipes, terminals, or a failed mmap: buffered reads
+    buffer.resize(READ_CHUNK);
+    return true;
+}
+
+// Served exactly like a mapping, minus the page releasing
+void LineReader::openText(string_view text) {
+    close();
+    data = text.data();
+    size = text.size();
+    mapped = true;
+}
+
+void LineReader::close() {
+    if (data && ownsMap) munmap(const_cast<char*>(data), size);
+    if (ownsFd && fd >= 0) ::close(fd);
+    fd = -1;
+    ownsFd = false;
+    mapped = ownsMap = false;
+    data = nullptr;
+    size = cursor = released = 0;
+    buffer.clear();
+    begin = end = 0;
+    eof = false;
+}
+
+// Move the unread tail to the front and read more behind it, doubling
+// the buffer when one line fills it
+bool LineReader::refill() {
+    if (eof) return false;
+
+    if (begin > 0) {
+        memmove(buffer.data(), buffer.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+    }
+    if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+
+    ssize_t n;
+    do {
+        n = read(fd, buffer.data() + end, buffer.size() - end);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        eof = true;
+        return false;
+    }
+    end += n;
+    return true;
+}
+
+bool LineReader::nextLine(string_view& line) {
+    if (mapped) {
+        if (cursor >= size) return false;
+        const char* start = data + cursor;
+        const char* nl = static_cast<const char*>(memchr(start, '\n', size - cursor));
+        size_t length = nl ? nl - start : size - cursor;
+        line = string_view(start, length);
+        cursor += length + (nl ? 1 : 0);
+
+        // Clean private pages just re-fault from the file if a view still
+        // points behind the cursor, so this is always safe
+        if (ownsMap && cursor - released >= RELEASE_STEP) {
+            size_t upto = cursor & ~(static_cast<size_t>(sysconf(_SC_PAGESIZE)) - 1);
+            madvise(const_cast<char*>(data) + released, upto - released, MADV_DONTNEED);
+            released = upto;
+        }
+        return true;
+    }
+
+    if (fd < 0) return false;
+
+    size_t scanned = begin;
+    while (true) {
+        const char* nl = static_cast<const char*>(
+            memchr(buffer.data() + scanned, '\n', end - scanned));
+        if (nl) {
+            size_t length = nl - (buffer.data() + begin);
+            line = string_view(buffer.data() + begin, length);
+            begin += length + 1;
+            return true;
+        }
+
+        size_t pending = end - begin;
+        if (!refill()) {
+            if (end == begin) return false;
+            line = string_view(buffer.data() + begin, end - begin);
+            begin = end;
+            return true;
+        }
+        scanned = begin + pending;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* ——— Zero-copy line reader ———
+   Regular files are mmapped read-only with an MADV_SEQUENTIAL hint and
+   lines are handed out as views straight into the mapping.  Pipes, stdin
+   ("-") and anything else mmap refuses fall back to large buffered
+   read()s.  Pages already read past are released every 64 MB, so even a
+   file larger than RAM never stays resident.  Lines follow std::getline: split on '\n', no empty line after
+   a final newline, and a '\r' before the newline is kept.              */
+class LineReader {
+public:
+    LineReader() {}
+    ~LineReader() { close(); }
+
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    bool open(const std::string& path);
+    void openText(std::string_view text);   // lines of text already in memory, which must outlive the reader
+    void close();
+
+    // Views into a mapped file stay valid until close(); in buffered
+    // mode only until the next call.
+    bool nextLine(std::string_view& line);
+
+    bool isMapped() const { return mapped; }
+
+private:
+    bool refill();
+
+    int fd = -1;
+    bool ownsFd = false;
+
+    // mapped mode
+    bool mapped = false;
+    bool ownsMap = false;    // false when data is the caller's text
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t cursor = 0;
+    size_t released = 0;     // pages before this were handed back (MADV_DONTNEED)
+
+    // buffered mode: unread bytes are buffer[begin, end)
+    std::vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    bool eof = false;
+};
+
+#endif   // LINE_READER_H
@@ -0,0 +1,93 @@
+#include "ll1.h"
+
+#include <sstream>
+
+using namespace std;
+
+
+/* Per-thread parse state, shared by every CompiledParser the thread
+   uses: nothing in it depends on the grammar, and after the first few
+   parses its buffers and arena are big enough that a parse allocates
+   only its result. */
+namespace {
+
+struct ThreadState {
+    ParseContext ctx;
+    ostringstream diag;
+};
+
+ThreadState& threadState()
+{
+    thread_local ThreadState state;
+    return state;
+}
+
+}
+
+shared_ptr<const CompiledParser> CompiledParser::compile(string_view grammarText, string* error,
+                                                        shared_ptr<GrammarPool> pool)
+{
+    shared_ptr<CompiledParser> parser(new CompiledParser);
+    CFGProcessor& proc = parser->processor;
+    if (pool) proc.setPool(move(pool));
+    if (!proc.loadGrammar(grammarText) || !proc.buildTables()) {
+        if (error) *error = proc.error();
+        return nullptr;
+    }
+    parser->pooled = proc.shareStorage();
+    return parser;
+}
+
+ParseResult CompiledParser::parse(string_view input, bool withTree) const
+{
+    ThreadState& state = threadState();
+    ParseContext& ctx = state.ctx;
+    ParseResult result;
+
+    state.diag.str("");
+    ctx.diag = &state.diag;
+    ctx.errors = &result.errors;
+    if (withTree) {
+        ctx.lineArena.reset();
+        ctx.treeArena = &ctx.lineArena;
+    }
+
+    result.accepted = processor.parseInto(input, 1, ctx);
+
+    if (withTree) {
+        flattenPreorder(ctx.tree, result.tree);
+        ctx.treeArena = nullptr;
+    }
+    ctx.errors = nullptr;
+    result.warnings = state.diag.str();
+    return result;
+}
+
+vector<ParseResult> CompiledParser::parseBatch(const string_view* inputs, size_t count, bool withTree) const
+{
+    vector<ParseResult> results;
+    results.reserve(count);
+    for (size_t i = 0; i < count; i++) results.push_back(parse(inputs[i], withTree));
+    return results;
+}
+
+vector<ParseResult> CompiledParser::parseBatch(const vector<string_view>& inputs, bool withTree) const
+{
+    return parseBatch(inputs.data(), inputs.size(), withTree);
+}
+
+GrammarBuilder& GrammarBuilder::append(string_view lines)
+{
+    source += lines;
+    if (!source.empty() && source.back() != '\n') source += '\n';
+    return *this;
+}
+
+GrammarBuilder& GrammarBuilder::rule(string_view lhs, string_view alternatives)
+{
+    source += lhs;
+    source += " -> ";
+    source += alternatives;
+    source += '\n';
+    return *this;
+}
@@ -0,0 +1,81 @@
+#ifndef LL1_H
+#define LL1_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "parseTree.h"
+#include "sourceCFG.h"
+
+/* ——— Embeddable parser API ———
+   For linking the parser into another program: no files, no console
+   output, no exit().  A GrammarBuilder collects grammar text (the
+   grammar file's format) and compiles it once into a CompiledParser,
+   which never changes afterwards, so one instance can be shared by any
+   number of threads.  Each thread parses with its own reusable state.
+
+       std::string error;
+       auto parser = GrammarBuilder()
+                         .rule("S", "id = E ;")
+                         .rule("E", "E + id | id")
+                         .compile(&error);
+       ParseResult r = parser->parse("x = y + z ;");                  */
+
+struct ParseResult {
+    bool accepted = false;
+    std::vector<SyntaxError> errors;        // in input order; empty when accepted
+    std::string warnings;                   // lexer diagnostics (unrecognised characters)
+    std::vector<PreorderNode> tree;         // preorder parse tree, only if asked for
+};
+
+class CompiledParser {
+public:
+    // The grammar file's format; nullptr (and the reason in error) if it
+    // doesn't compile.  A grammar that isn't LL(1) still compiles, with
+    // conflicts resolved as the table report describes.  Its symbol names
+    // and right-hand sides are kept in pool, shared with every other
+    // parser compiled into the same one; without a pool they are still
+    // stored once each, in a pool of the parser's own.
+    static std::shared_ptr<const CompiledParser> compile(std::string_view grammarText,
+                                                         std::string* error = nullptr,
+                                                         std::shared_ptr<GrammarPool> pool = nullptr);
+
+    // Each input is one sentence of the start symbol; error lines are 1
+    ParseResult parse(std::string_view input, bool withTree = false) const;
+    std::vector<ParseResult> parseBatch(const std::string_view* inputs, size_t count,
+                                        bool withTree = false) const;
+    std::vector<ParseResult> parseBatch(const std::vector<std::string_view>& inputs,
+                                        bool withTree = false) const;
+
+    size_t conflictCount() const { return processor.conflictCount(); }
+    size_t pooledBytes() const { return pooled; }   // names and right-hand sides it refers to
+    // Names for the symbol and production ids in a tree
+    const std::string& symbolName(Symbol s) const { return processor.symbols().name(s); }
+    std::string productionText(int production) const { return processor.productionText(production, " -> "); }
+
+private:
+    CompiledParser() {}
+    CFGProcessor processor;
+    size_t pooled = 0;
+};
+
+class GrammarBuilder {
+public:
+    explicit GrammarBuilder(std::string_view text = std::string_view()) { append(text); }
+
+    GrammarBuilder& append(std::string_view lines);                           // raw grammar text
+    GrammarBuilder& rule(std::string_view lhs, std::string_view alternatives); // "lhs -> alternatives"
+
+    const std::string& text() const { return source; }
+    std::shared_ptr<const CompiledParser> compile(std::string* error = nullptr) const {
+        return CompiledParser::compile(source, error);
+    }
+
+private:
+    std::string source;
+};
+
+#endif   // LL1_H
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "server.h"
+#include "sourceCFG.h"
+
+using namespace std;
+
+/* -----------------------------------------------------------------
+   ──────────────  Main  ──────────────
+------------------------------------------------------------------*/
+
+int main(int argc, char* argv[])
+{
+    vector<string> files;  TraceLevel level = TRACE_FULL;  int jobs = 1;  string cache;
+    string header;  EmitStyle style = EMIT_TABLE;  bool tree = false;  bool wholeFile = false;
+    string metricsFile;  MetricsFormat metricsFormat = METRICS_JSON;
+    ServerOptions serve;  bool watch = false;  TableFormat tableFormat = TABLE_AUTO;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg.rfind("--trace=", 0) == 0) {
+            if (!parseTraceLevel(arg.substr(8), level)) {
+                cerr << "Unknown trace level: " << arg.substr(8) << '\n';
+                return 1;
+            }
+        }
+        else if (arg.rfind("--jobs=", 0) == 0) jobs = atoi(arg.c_str() + 7);
+        else if (arg.rfind("--cache=", 0) == 0) cache = arg.substr(8);
+        else if (arg == "--tree") tree = true;
+        else if (arg == "--whole-file") wholeFile = true;
+        else if (arg.rfind("--metrics=", 0) == 0) metricsFile = arg.substr(10);
+        else if (arg.rfind("--metrics-format=", 0) == 0) {
+            if (!parseMetricsFormat(arg.substr(17), metricsFormat)) {
+                cerr << "Unknown metrics format: " << arg.substr(17) << '\n';
+                return 1;
+            }
+        }
+        else if (arg.rfind("--serve=", 0) == 0) serve.endpoint = arg.substr(8);
+        else if (arg.rfind("--queue=", 0) == 0) serve.queueLimit = atoi(arg.c_str() + 8);
+        else if (arg == "--watch") watch = true;
+        else if (arg.rfind("--table=", 0) == 0) {
+            if (!parseTableFormat(arg.substr(8), tableFormat)) {
+                cerr << "Unknown table format: " << arg.substr(8) << '\n';
+                return 1;
+            }
+        }
+        else if (arg.rfind("--emit-parser=", 0) == 0) header = arg.substr(14);
+        else if (arg.rfind("--emit-style=", 0) == 0) {
+            if (!parseEmitStyle(arg.substr(13), style)) {
+                cerr << "Unknown emit style: " << arg.substr(13) << '\n';
+                return 1;
+            }
+        }
+        else files.push_back(arg);
+    }
+
+    if (files.size() != (serve.endpoint.empty() ? 3 : 1)) {
+        cerr << "Usage: " << argv[0]
+             << " grammar.txt input.txt output.txt"
+             << " [--trace=none|errors|summary|full] [--jobs=N] [--cache=FILE] [--tree] [--whole-file]"
+             << " [--metrics=FILE] [--metrics-format=json|prometheus]"
+             << " [--table=auto|dense|packed]"
+             << " [--emit-parser=FILE.h] [--emit-style=table|rd]\n"
+             << "       " << argv[0] << " grammar.txt --serve=-|SOCKET [--jobs=N] [--queue=N] [--watch]\n";
+        return 1;
+    }
+
+    /* Server mode: compile once, then answer requests (server.h) */
+    if (!serve.endpoint.empty()) {
+        GrammarRegistry registry;
+        string error;
+        bool loaded;
+        if (watch) {
+            // Reloads are compiled in the background; a broken edit keeps the old grammar serving
+            registry.setReloadListener([](const string& name, const GrammarVersion* v, const string& why) {
+                if (v) cerr << "Reloaded " << name << " (version " << v->version << ")\n";
+                else cerr << "Reload of " << name << " failed, keeping the previous version: " << why << '\n';
+            });
+            loaded = registry.watch(files[0], files[0], &error);
+        }
+        else {
+            ifstream grammarIn(files[0]);
+            if (!grammarIn) {
+                cerr << "Error opening file: " << files[0] << '\n';
+                return 1;
+            }
+            ostringstream text;
+            text << grammarIn.rdbuf();
+            loaded = registry.publish(files[0], text.str(), &error) != nullptr;
+        }
+        if (!loaded) {
+            cerr << error << '\n';
+            return 1;
+        }
+        serve.workers = jobs;
+        return runServer(registry, files[0], serve);
+    }
+
+    if (!metricsFile.empty() && !METRICS_ENABLED) {
+        cerr << "--metrics: this build has metrics compiled out (LL1_METRICS=0)\n";
+        return 1;
+    }
+
+    CFGProcessor proc(files[0], files[2]);
+    if (proc.failed()) {
+        cerr << proc.error() << '\n';
+        return 1;
+    }
+    proc.setMetricsOutput(metricsFile, metricsFormat);
+    proc.traceSink().level = level;
+    proc.setJobs(jobs);
+    proc.setTableFormat(tableFormat);
+    proc.setPrintTrees(tree);
+    proc.setWholeFile(wholeFile);
+    if (cache.empty()) {
+        proc.displayResults();       // grammar → FIRST/FOLLOW/table
+    }
+    else if (!proc.loadCache(cache)) {
+        if (!proc.reanalyze(cache) && !proc.failed())   // older cache: reuse what the edit didn't touch
+            proc.buildTables();      // same tables, reports skipped
+        if (!proc.failed() && !proc.saveCache(cache))
+            cerr << "Warning: couldn't write grammar cache " << cache << '\n';
+    }
+    if (proc.failed()) {
+        cerr << proc.error() << '\n';
+        return 1;
+    }
+    if (!cache.empty() && proc.conflictCount() > 0)
+        cerr << "Warning: grammar is not LL(1) (" << proc.conflictCount()
+             << " conflicting table cells)\n";
+    if (!header.empty() && !proc.emitParser(header, style)) {
+        cerr << "Couldn't write the generated parser: " << header << '\n';
+        return 1;
+    }
+    proc.parseInputFile(files[1]);   // now parse the supplied strings
+
+    if (!metricsFile.empty() && !proc.writeMetrics())
+        cerr << "Warning: couldn't write metrics to " << metricsFile << '\n';
+
+    proc.writeConsole("\nProcessing complete.  Results written to " + files[2] + "\n");
+    proc.writeOutputFile("\nProcessing complete.\n");
+    if (!proc.flushOutput()) {
+        cerr << "Couldn't write the output: " << files[2] << '\n';
+        return 1;
+    }
+    return 0;
+}
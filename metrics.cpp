@@ -0,0 +1,111 @@
+#include "metrics.h"
+
+#include <csignal>
+#include <cstdio>
+using namespace std;
+
+
+void ParseCounters::add(const ParseCounters& other) {
+    lines += other.lines;
+    linesWithErrors += other.linesWithErrors;
+    tokensLexed += other.tokensLexed;
+    tableLookups += other.tableLookups;
+    expansions += other.expansions;
+    matches += other.matches;
+    recoverySkips += other.recoverySkips;
+    parseSteps += other.parseSteps;
+    stackDepthSum += other.stackDepthSum;
+    if (other.maxStackDepth > maxStackDepth) maxStackDepth = other.maxStackDepth;
+}
+
+void Metrics::addPhase(const string& phase, double seconds) {
+    for (int i = 0; i < phases.size(); i++) {
+        if (phases[i].first == phase) {
+            phases[i].second += seconds;
+            return;
+        }
+    }
+    phases.push_back({phase, seconds});
+}
+
+bool parseMetricsFormat(const string& name, MetricsFormat& format) {
+    if (name == "json")       { format = METRICS_JSON;       return true; }
+    if (name == "prometheus") { format = METRICS_PROMETHEUS; return true; }
+    return false;
+}
+
+static string number(double value) {
+    char buf[32];
+    snprintf(buf, sizeof buf, "%.9g", value);
+    return buf;
+}
+
+string formatMetrics(const Metrics& metrics, MetricsFormat format) {
+    const ParseCounters& p = metrics.parse;
+    const pair<const char*, uint64_t> counters[] = {
+        {"lines", p.lines},
+        {"lines_with_errors", p.linesWithErrors},
+        {"tokens_lexed", p.tokensLexed},
+        {"table_lookups", p.tableLookups},
+        {"expansions", p.expansions},
+        {"matches", p.matches},
+        {"recovery_skips", p.recoverySkips},
+        {"parse_steps", p.parseSteps},
+    };
+    double meanDepth = p.parseSteps ? double(p.stackDepthSum) / p.parseSteps : 0.0;
+
+    string out;
+    if (format == METRICS_JSON) {
+        out = "{\n  \"phase_seconds\": {";
+        for (int i = 0; i < metrics.phases.size(); i++) {
+            out += (i ? ",\n    \"" : "\n    \"") + metrics.phases[i].first + "\": " +
+                   number(metrics.phases[i].second);
+        }
+        out += metrics.phases.empty() ? "},\n" : "\n  },\n";
+        out += "  \"parse_table\": {\n"
+               "    \"format\": \"" + string(metrics.tablePacked ? "packed" : "dense") + "\",\n"
+               "    \"dense_bytes\": " + to_string(metrics.denseTableBytes) + ",\n"
+               "    \"packed_bytes\": " + to_string(metrics.packedTableBytes) + "\n  },\n";
+        out += "  \"parse\": {\n";
+        for (const auto& c : counters) {
+            out += "    \"" + string(c.first) + "\": " + to_string(c.second) + ",\n";
+        }
+        out += "    \"max_stack_depth\": " + to_string(p.maxStackDepth) + ",\n"
+               "    \"mean_stack_depth\": " + number(meanDepth) + "\n  }\n}\n";
+    }
+    else {
+        out = "# TYPE ll1_phase_seconds gauge\n";
+        for (int i = 0; i < metrics.phases.size(); i++) {
+            out += "ll1_phase_seconds{phase=\"" + metrics.phases[i].first + "\"} " +
+                   number(metrics.phases[i].second) + "\n";
+        }
+        out += "# TYPE ll1_parse_table_bytes gauge\n"
+               "ll1_parse_table_bytes{format=\"dense\",in_use=\"" + string(metrics.tablePacked ? "0" : "1") +
+               "\"} " + to_string(metrics.denseTableBytes) + "\n"
+               "ll1_parse_table_bytes{format=\"packed\",in_use=\"" + string(metrics.tablePacked ? "1" : "0") +
+               "\"} " + to_string(metrics.packedTableBytes) + "\n";
+        for (const auto& c : counters) {
+            out += "# TYPE ll1_" + string(c.first) + "_total counter\n"
+                   "ll1_" + string(c.first) + "_total " + to_string(c.second) + "\n";
+        }
+        out += "# TYPE ll1_max_stack_depth gauge\nll1_max_stack_depth " + to_string(p.maxStackDepth) + "\n"
+               "# TYPE ll1_mean_stack_depth gauge\nll1_mean_stack_depth " + number(meanDepth) + "\n";
+    }
+    return out;
+}
+
+static volatile sig_atomic_t metricsRequested = 0;
+
+static void onMetricsSignal(int) {
+    metricsRequested = 1;
+}
+
+void installMetricsSignal() {
+    signal(SIGUSR1, onMetricsSignal);
+}
+
+bool takeMetricsRequest() {
+    if (!metricsRequested) return false;
+    metricsRequested = 0;
+    return true;
+}
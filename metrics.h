@@ -0,0 +1,82 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* ——— Phase timers and parse counters ———
+   Build with -DLL1_METRICS=0 to compile every timer and counter out:
+   they all sit behind `if constexpr (METRICS_ENABLED)`, so nothing is
+   left of them in the binary.  Counters live in each thread's
+   ParseContext and are only summed when a chunk (or the whole run) is
+   done, so workers never share a cache line.                          */
+#ifndef LL1_METRICS
+#define LL1_METRICS 1
+#endif
+
+constexpr bool METRICS_ENABLED = LL1_METRICS != 0;
+
+struct ParseCounters {
+    uint64_t lines = 0;
+    uint64_t linesWithErrors = 0;
+    uint64_t tokensLexed = 0;
+    uint64_t tableLookups = 0;
+    uint64_t expansions = 0;
+    uint64_t matches = 0;
+    uint64_t recoverySkips = 0;      // tokens skipped or terminals popped after an error
+    uint64_t parseSteps = 0;         // driver steps, each one stack-depth sample
+    uint64_t stackDepthSum = 0;      // stack depth summed over those steps
+    uint64_t maxStackDepth = 0;      // deepest stack of any line
+
+    void add(const ParseCounters& other);
+};
+
+struct Metrics {
+    std::vector<std::pair<std::string, double>> phases;    // wall seconds, first-run order
+    ParseCounters parse;
+    // Parse-table bytes in each form, and whether the driver reads the packed one
+    uint64_t denseTableBytes = 0;
+    uint64_t packedTableBytes = 0;
+    bool tablePacked = false;
+
+    void addPhase(const std::string& phase, double seconds);
+};
+
+enum MetricsFormat {
+    METRICS_JSON,
+    METRICS_PROMETHEUS
+};
+
+bool parseMetricsFormat(const std::string& name, MetricsFormat& format);
+std::string formatMetrics(const Metrics& metrics, MetricsFormat format);
+
+// SIGUSR1 asks for a snapshot; the parse loops poll for it between lines
+// and, for long sentences (--whole-file), every few thousand tokens
+void installMetricsSignal();
+bool takeMetricsRequest();
+
+// Adds its lifetime to metrics under phase
+class PhaseTimer {
+public:
+    PhaseTimer(Metrics& metrics, const char* phase) : metrics(metrics), phase(phase) {
+        if constexpr (METRICS_ENABLED) start = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if constexpr (METRICS_ENABLED)
+            metrics.addPhase(phase, std::chrono::duration<double>(
+                                        std::chrono::steady_clock::now() - start).count());
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    Metrics& metrics;
+    const char* phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif   // METRICS_H
@@ -0,0 +1,147 @@
+#include "outputWriter.h"
+
+#include <algorithm>
+
+using namespace std;
+
+
+// A rendered buffer at least this big is queued as it is rather than copied
+static constexpr size_t TAKE_BYTES = 64 << 10;
+static constexpr size_t MAX_SPARE = 4;
+
+unsigned OutputWriter::addStream(FILE* stream)
+{
+    if (!stream || sinks.size() >= 32) return 0;
+    flush();
+    sinks.push_back({stream, false});
+    unsigned bit = 1u << (sinks.size() - 1);
+    allSinks |= bit;
+    return bit;
+}
+
+unsigned OutputWriter::addFile(const string& path)
+{
+    FILE* stream = fopen(path.c_str(), "w");
+    if (!stream) return 0;
+    unsigned bit = addStream(stream);
+    if (!bit) fclose(stream);
+    else sinks.back().owned = true;
+    return bit;
+}
+
+void OutputWriter::setBudget(size_t bytes)
+{
+    lock_guard<mutex> lock(m);
+    budget = bytes;
+}
+
+void OutputWriter::write(const string& text, unsigned to)
+{
+    to &= allSinks;
+    if (!to || text.empty()) return;
+    if (to != fillSinks && !fill.empty()) handOff();
+    fillSinks = to;
+    fill += text;
+    if (fill.size() >= BATCH_BYTES) handOff();
+}
+
+void OutputWriter::writeBuffer(string& text)
+{
+    if (text.size() < TAKE_BYTES) {
+        write(text);
+        return;
+    }
+    if (!allSinks) return;
+    handOff();                          // what's already buffered goes first
+    enqueue({move(text), allSinks});
+    text.clear();
+}
+
+void OutputWriter::handOff()
+{
+    if (fill.empty()) return;
+    Batch batch{move(fill), fillSinks};
+    fill.clear();
+    {
+        lock_guard<mutex> lock(m);
+        if (!spare.empty()) {
+            fill.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+    if (fill.capacity() < BATCH_BYTES) fill.reserve(BATCH_BYTES + BATCH_BYTES / 4);
+    enqueue(move(batch));
+}
+
+// One batch past the budget is let through, so a buffer bigger than the
+// whole budget can't wait forever
+void OutputWriter::enqueue(Batch batch)
+{
+    unique_lock<mutex> lock(m);
+    drained.wait(lock, [&] { return queuedBytes == 0 || queuedBytes + batch.text.size() <= budget; });
+    queuedBytes += batch.text.size();
+    queue.push_back(move(batch));
+    if (!writer.joinable()) writer = thread(&OutputWriter::run, this);
+    ready.notify_one();
+}
+
+void OutputWriter::run()
+{
+    unique_lock<mutex> lock(m);
+    while (true) {
+        ready.wait(lock, [&] { return !queue.empty() || stopping; });
+        if (queue.empty()) return;
+        Batch batch = move(queue.front());
+        queue.pop_front();
+        busy = true;
+        lock.unlock();
+
+        bool ok = true;
+        for (size_t i = 0; i < sinks.size(); i++) {
+            if (!(batch.sinks & (1u << i))) continue;
+            FILE* stream = sinks[i].stream;
+            ok &= fwrite(batch.text.data(), 1, batch.text.size(), stream) == batch.text.size();
+            ok &= fflush(stream) == 0;
+        }
+
+        lock.lock();
+        if (!ok) writeFailed = true;
+        queuedBytes -= batch.text.size();
+        busy = false;
+        if (spare.size() < MAX_SPARE && batch.text.capacity() <= 2 * BATCH_BYTES) {
+            batch.text.clear();
+            spare.push_back(move(batch.text));
+        }
+        drained.notify_all();
+    }
+}
+
+void OutputWriter::flush()
+{
+    handOff();
+    unique_lock<mutex> lock(m);
+    drained.wait(lock, [&] { return queue.empty() && !busy; });
+}
+
+void OutputWriter::close()
+{
+    flush();
+    {
+        lock_guard<mutex> lock(m);
+        stopping = true;
+    }
+    ready.notify_all();
+    if (writer.joinable()) writer.join();
+    for (Sink& sink : sinks) {
+        if (sink.owned) fclose(sink.stream);
+    }
+    sinks.clear();
+    allSinks = fillSinks = 0;
+    stopping = false;
+}
+
+bool OutputWriter::failed()
+{
+    lock_guard<mutex> lock(m);
+    return writeFailed;
+}
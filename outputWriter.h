@@ -0,0 +1,77 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+/* ——— Report and trace output ———
+   Text is formatted once and appended to a large buffer; each full
+   buffer goes to a background thread that writes it to every sink it
+   is addressed to (the console, the output file).  Sinks are flushed
+   after each buffer, by flush() and on close, never per line.  Queued
+   buffers are capped by a memory budget; past it the producer waits for
+   the writer to catch up.  Like any TraceSink it has one producer at a
+   time.  With no sinks, text is dropped and no thread is started.      */
+class OutputWriter : public TraceSink {
+public:
+    static constexpr size_t BATCH_BYTES = 1 << 20;         // buffer size handed to the writer
+    static constexpr size_t DEFAULT_BUDGET = 16 << 20;     // queued bytes before write() waits
+
+    explicit OutputWriter(TraceLevel level = TRACE_FULL) : TraceSink(level) {}
+    ~OutputWriter() override { close(); }
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    // Each sink gets one bit, for write(text, sinks); 0 if it can't be added
+    unsigned addStream(FILE* stream);                   // left open by close()
+    unsigned addFile(const std::string& path);          // created or truncated
+    void setBudget(size_t bytes);
+
+    void write(const std::string& text) override { write(text, allSinks); }
+    void write(const std::string& text, unsigned sinks);
+    void writeBuffer(std::string& text) override;       // may take text's storage
+
+    void flush();                // everything written so far has reached its sinks
+    void close();                // flush, stop the writer, close the files it opened
+    bool failed();               // a sink write has failed
+
+private:
+    struct Sink {
+        FILE* stream;
+        bool owned;
+    };
+    struct Batch {
+        std::string text;
+        unsigned sinks;
+    };
+
+    void handOff();                                     // queue the fill buffer
+    void enqueue(Batch batch);
+    void run();
+
+    std::vector<Sink> sinks;                            // only changed while the writer is idle
+    unsigned allSinks = 0;
+    std::string fill;                                   // producer side, not yet queued
+    unsigned fillSinks = 0;
+
+    std::mutex m;
+    std::condition_variable ready, drained;
+    std::deque<Batch> queue;
+    std::vector<std::string> spare;                     // written buffers, kept for their capacity
+    size_t queuedBytes = 0;
+    size_t budget = DEFAULT_BUDGET;
+    bool busy = false;                                  // the writer holds a batch
+    bool stopping = false;
+    bool writeFailed = false;
+    std::thread writer;                                 // started by the first batch
+};
+
+#endif   // OUTPUT_WRITER_H
@@ -0,0 +1,96 @@
+#ifndef PACKED_TABLE_H
+#define PACKED_TABLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+/* ——— Row-displacement ("comb vector") table ———
+   The rows of a sparse rows x columns table are slid over one another
+   into a single array of cells, each row at an offset where none of its
+   filled cells lands on another row's.  Row r, column c lives at
+   cells[offsets[r] + c] and the cell records the row that owns it, so
+   a lookup is two loads and a compare, and the size follows the number
+   of filled cells rather than rows x columns.                          */
+class PackedTable {
+public:
+    // dense is row-major; cells equal to empty are left out
+    void build(const std::vector<int>& dense, int rows, int columns, int empty) {
+        emptyValue = empty;
+        std::vector<std::vector<int>> filled(rows);
+        for (int r = 0; r < rows; r++) {
+            for (int c = 0; c < columns; c++) {
+                if (dense[size_t(r) * columns + c] != empty) filled[r].push_back(c);
+            }
+        }
+
+        // Fullest rows first, each at the lowest offset it fits (first fit).
+        // A row that finds no gap within MAX_PROBES offsets goes past the
+        // end instead, which keeps rows that don't interleave linear.
+        std::vector<int> order(rows);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&](int a, int b) { return filled[a].size() > filled[b].size(); });
+        offsets.assign(rows, 0);
+        std::vector<bool> used;
+        size_t firstFree = 0, end = columns;
+        for (int r : order) {
+            const std::vector<int>& cols = filled[r];
+            if (cols.empty()) break;                    // offset 0: every cell there is someone else's
+            size_t offset = firstFree > size_t(cols[0]) ? firstFree - cols[0] : 0;
+            auto clashes = [&](size_t at) {
+                for (int c : cols) {
+                    if (at + c < used.size() && used[at + c]) return true;
+                }
+                return false;
+            };
+            for (int probes = 0; clashes(offset); probes++) {
+                if (probes == MAX_PROBES) {
+                    offset = std::max(offset, used.size() - std::min(used.size(), size_t(cols[0])));
+                    break;
+                }
+                offset++;
+            }
+            offsets[r] = static_cast<uint32_t>(offset);
+            if (used.size() < offset + cols.back() + 1) used.resize(offset + cols.back() + 1, false);
+            for (int c : cols) used[offset + c] = true;
+            while (firstFree < used.size() && used[firstFree]) firstFree++;
+            end = std::max(end, offset + columns);      // any column of any row stays in bounds
+        }
+
+        cells.assign(end, Cell{-1, empty});
+        for (int r = 0; r < rows; r++) {
+            for (int c : filled[r]) cells[offsets[r] + c] = Cell{r, dense[size_t(r) * columns + c]};
+        }
+        cells.shrink_to_fit();
+    }
+
+    void clear() {
+        offsets.clear();  offsets.shrink_to_fit();
+        cells.clear();    cells.shrink_to_fit();
+    }
+
+    // Branch-free: a miss is as likely as a hit during error recovery
+    int at(int row, int column) const {
+        const Cell& cell = cells[offsets[row] + column];
+        const int32_t hit = -static_cast<int32_t>(cell.row == row);
+        return (cell.value & hit) | (emptyValue & ~hit);
+    }
+
+    size_t bytes() const { return offsets.size() * sizeof(uint32_t) + cells.size() * sizeof(Cell); }
+
+private:
+    static constexpr int MAX_PROBES = 256;
+
+    struct Cell {
+        int32_t row;                // owner, -1 = unused
+        int32_t value;
+    };
+    std::vector<uint32_t> offsets;
+    std::vector<Cell> cells;
+    int emptyValue = -1;
+};
+
+#endif   // PACKED_TABLE_H
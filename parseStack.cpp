@@ -8,248 +8,569 @@
 #include <algorithm>
 #include <iomanip>
 #include <stack>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
 
 #include "sourceCFG.h"
 
 using namespace std;
 
 /* -----------------------------------------------------------------
-   ───────  Pretty-printing helpers (unchanged from last version) ───────
+   ───────  Pretty-printing helpers  ───────
 ------------------------------------------------------------------*/
 static constexpr int COL_W = 40;
 static constexpr int ACT_W = 30;
 
-void CFGProcessor::printTableHeader()
+bool parseTraceLevel(const string& name, TraceLevel& level)
+{
+    if (name == "none")    { level = TRACE_NONE;    return true; }
+    if (name == "errors")  { level = TRACE_ERRORS;  return true; }
+    if (name == "summary") { level = TRACE_SUMMARY; return true; }
+    if (name == "full")    { level = TRACE_FULL;    return true; }
+    return false;
+}
+
+void CFGProcessor::printTableHeader(TraceSink& out) const
 {
     const string sep = "+" + string(COL_W, '-') + "+" +
                        string(COL_W, '-') + "+" +
                        string(ACT_W, '-') + "+";
 
-    auto hdr = [&](ostream& os)
-    {
-        os << sep << '\n'
-           << "|" << setw(COL_W) << left << " STACK"
-           << "|" << setw(COL_W) << left << " INPUT"
-           << "|" << setw(ACT_W) << left << " ACTION"
-           << "|\n" << sep << '\n';
-    };
-    hdr(cout);
-    if (outputFile.is_open()) hdr(outputFile);
+    ostringstream os;
+    os << sep << '\n'
+       << "|" << setw(COL_W) << left << " STACK"
+       << "|" << setw(COL_W) << left << " INPUT"
+       << "|" << setw(ACT_W) << left << " ACTION"
+       << "|\n" << sep << '\n';
+    out.write(os.str());
 }
 
-void CFGProcessor::displayStack(stack<string> s,
-                                const string& input,
-                                int position,
-                                const string& action)
+void CFGProcessor::displayStack(const ParseContext& ctx,
+                                const string& inpCol,
+                                const string& action) const
 {
-    vector<string> tmp;
-    while (!s.empty()) { tmp.push_back(s.top()); s.pop(); }
+    const SymbolStack& st = ctx.stack;
 
     string stackCol;
-    for (int i = static_cast<int>(tmp.size()) - 1; i >= 0; --i)
-        stackCol += tmp[i] + " ";
+    for (size_t i = 0; i < st.size(); ++i)
+        stackCol += grammar.symbols.name(st[i]) + " ";
     if (stackCol.empty()) stackCol = "ε";
 
-    /* build INPUT column */
-    int tPos = position;  string tok, inpCol;
-    while ((tok = getNextToken(input, tPos)) != "$") {
-        inpCol += tok + " ";
-        if (tPos >= static_cast<int>(input.length())) break;
-    }
-    inpCol += "$";
-
-    auto row = [&](ostream& os)
-    {
-        os << "|" << setw(COL_W) << left << stackCol.substr(0, COL_W - 1)
-           << "|" << setw(COL_W) << left << inpCol.substr(0, COL_W - 1)
-           << "|" << setw(ACT_W) << left << action.substr(0, ACT_W - 1)
-           << "|\n";
-    };
-    row(cout);
-    if (outputFile.is_open()) row(outputFile);
+    ostringstream os;
+    os << "|" << setw(COL_W) << left << stackCol.substr(0, COL_W - 1)
+       << "|" << setw(COL_W) << left << inpCol.substr(0, COL_W - 1)
+       << "|" << setw(ACT_W) << left << action.substr(0, ACT_W - 1)
+       << "|\n";
+    ctx.out->write(os.str());
 }
 
 /* -----------------------------------------------------------------
-   ───────  File-level driver (changed!)  ───────
+   ───────  File-level driver  ───────
 ------------------------------------------------------------------*/
 
 void CFGProcessor::parseInputFile(const string& inputFilename)
 {
-    ifstream fin(inputFilename);
-    if (!fin.is_open()) {
+    TraceSink& out = *trace;
+    PhaseTimer timer(metrics, "parseInputFile");
+
+    LineReader fin;
+    if (!fin.open(inputFilename)) {
         cerr << "Error opening input file: " << inputFilename << '\n';
-        if (outputFile.is_open())
-            outputFile << "Error opening input file: " << inputFilename << '\n';
+        writeOutputFile("Error opening input file: " + inputFilename + "\n");
         return;
     }
 
-    cout << "\n===== PARSING INPUT STRINGS =====\n\n";
-    if (outputFile.is_open())
-        outputFile << "\n===== PARSING INPUT STRINGS =====\n\n";
+    if (wholeFile) {
+        parseStream(fin, out);
+        return;
+    }
 
-    string line;  int lineNo = 0, totalErrors = 0;
+    if (out.level >= TRACE_SUMMARY)
+        out.write("\n===== PARSING INPUT STRINGS =====\n\n");
 
-    while (getline(fin, line))
-    {
-        lineNo++;
-        if (line.empty() || line[0] == '#') continue;
+    int totalErrors = 0;
 
-        /* ——— Heading & original source line ——— */
-        cout << "──────── Line " << lineNo << " ────────\n"
-             << "Code  : " << line << "\n";
-        if (outputFile.is_open()) {
-            outputFile << "──────── Line " << lineNo << " ────────\n"
-                       << "Code  : " << line << "\n";
+    if (jobs == 1) {
+        mainContext.out = &out;  mainContext.diag = &cerr;
+        string_view line;  int lineNo = 0;
+        while (fin.nextLine(line))
+        {
+            lineNo++;
+            if (line.empty() || line[0] == '#') continue;
+            if (!parseLine(line, lineNo, mainContext)) totalErrors++;
+            if constexpr (METRICS_ENABLED) pollMetrics();
         }
+    }
+    else totalErrors = parseInParallel(fin, out);
 
-        bool ok = parseString(line, lineNo);
-
-        /* ——— per-line result ——— */
-        if (ok) {
-            cout << "Result: Line " << lineNo << " parsed successfully.\n\n";
-            if (outputFile.is_open())
-                outputFile << "Result: Line " << lineNo
-                           << " parsed successfully.\n\n";
-        } else {
-            cout << "Result: Line " << lineNo << " contained syntax error(s).\n\n";
-            if (outputFile.is_open())
-                outputFile << "Result: Line " << lineNo
-                           << " contained syntax error(s).\n\n";
-            totalErrors++;
-        }
+    if (out.level >= TRACE_ERRORS)
+        out.write("Parsing completed with " + to_string(totalErrors) + " error(s).\n");
+}
+
+/* One source line: heading, the parse itself, and the per-line result */
+bool CFGProcessor::parseLine(string_view line, int lineNumber, ParseContext& ctx) const
+{
+    TraceSink& out = *ctx.out;
+
+    /* ——— Heading & original source line ——— */
+    if (out.level >= TRACE_SUMMARY)
+        out.write("──────── Line " + to_string(lineNumber) + " ────────\n"
+                  "Code  : " + string(line) + "\n");
+
+    const bool showTree = printTrees && out.level >= TRACE_SUMMARY;
+    if (showTree) {
+        ctx.lineArena.reset();
+        ctx.treeArena = &ctx.lineArena;
+    }
+
+    bool ok;
+    switch (out.level) {
+        case TRACE_NONE:    ok = runParse<TRACE_NONE>(line, lineNumber, ctx);    break;
+        case TRACE_ERRORS:  ok = runParse<TRACE_ERRORS>(line, lineNumber, ctx);  break;
+        case TRACE_SUMMARY: ok = runParse<TRACE_SUMMARY>(line, lineNumber, ctx); break;
+        default:            ok = runParse<TRACE_FULL>(line, lineNumber, ctx);    break;
+    }
+
+    if (showTree) {
+        out.write("Tree  :\n" + treeText(ctx.tree, line));
+        ctx.treeArena = nullptr;
     }
 
-    cout << "Parsing completed with " << totalErrors << " error(s).\n";
-    if (outputFile.is_open())
-        outputFile << "Parsing completed with " << totalErrors << " error(s).\n";
+    /* ——— per-line result ——— */
+    if (out.level >= TRACE_SUMMARY)
+        out.write("Result: Line " + to_string(lineNumber) +
+                  (ok ? " parsed successfully.\n\n"
+                      : " contained syntax error(s).\n\n"));
+    return ok;
+}
+
+/* The whole file as one sentence of the start symbol.  Tokens are
+   lexed a line at a time as the parser asks for them, so memory is the
+   parse stack plus one line, however large the file.  --tree and --jobs
+   don't apply: there is a single parse, and its tree would be as large
+   as the input. */
+bool CFGProcessor::parseStream(LineReader& in, TraceSink& out)
+{
+    mainContext.out = &out;  mainContext.diag = &cerr;
+    TokenStream tokens(in, lexer, mainContext.tokens, cerr);
+
+    if (out.level >= TRACE_SUMMARY)
+        out.write("\n===== PARSING INPUT FILE =====\n\n");
+
+    bool ok;
+    switch (out.level) {
+        case TRACE_NONE:    ok = drive<TRACE_NONE>(tokens, mainContext);    break;
+        case TRACE_ERRORS:  ok = drive<TRACE_ERRORS>(tokens, mainContext);  break;
+        case TRACE_SUMMARY: ok = drive<TRACE_SUMMARY>(tokens, mainContext); break;
+        default:            ok = drive<TRACE_FULL>(tokens, mainContext);    break;
+    }
+
+    if (out.level >= TRACE_ERRORS)
+        out.write(ok ? "Parsing completed: " + to_string(tokens.lines()) + " line(s) parsed successfully.\n"
+                     : "Parsing completed: the input contained syntax error(s).\n");
+    return ok;
 }
 
 /* -----------------------------------------------------------------
-   ───────  parseString (unchanged from last version)  ───────
+   ───────  Worker pool  ───────
+   The reader cuts the input into chunks of consecutive lines and queues
+   them; workers parse a chunk into its own in-memory trace with their
+   own ParseContext (the tables are shared read-only).  The reader writes
+   finished chunks back in their original order, so the output matches a
+   sequential run byte for byte.  Each chunk counts its own errors and
+   the reader sums them, so there is no shared counter to fight over.
+   At most WINDOW chunks per worker are in flight, which bounds memory.
 ------------------------------------------------------------------*/
-bool CFGProcessor::parseString(const string& input, int lineNumber)
+namespace {
+
+struct LineChunk {
+    vector<pair<int, string_view>> lines;   // (line number, text)
+    deque<string> copies;                   // backing text when the reader isn't mapped
+    string trace;                        // rendered output
+    string diag;                         // warnings, replayed on cerr
+    int errors = 0;
+    ParseCounters counters;
+    bool done = false;
+};
+
+constexpr size_t LINES_PER_CHUNK = 256;
+constexpr size_t WINDOW = 4;
+
+}
+
+int CFGProcessor::parseInParallel(LineReader& in, TraceSink& out)
 {
-    stack<string> st;  st.push("$");  st.push(grammar.startSymbol);
-    int pos = 0;  string la = getNextToken(input, pos);
+    unsigned workers = jobs > 0 ? jobs : max(1u, thread::hardware_concurrency());
+
+    mutex m;
+    condition_variable workReady, chunkDone;
+    deque<LineChunk*> queue;
+    bool noMoreWork = false;
+
+    auto worker = [&]() {
+        ParseContext ctx;
+        while (true) {
+            LineChunk* chunk;
+            {
+                unique_lock<mutex> lock(m);
+                workReady.wait(lock, [&] { return !queue.empty() || noMoreWork; });
+                if (queue.empty()) return;
+                chunk = queue.front();  queue.pop_front();
+            }
 
-    bool hadErr = false;  int errStreak = 0;  const int MAX_ERR = 10;
+            StringTrace chunkTrace(out.level);
+            ostringstream diag;
+            ctx.out = &chunkTrace;  ctx.diag = &diag;
+            for (auto& line : chunk->lines)
+                if (!parseLine(line.second, line.first, ctx)) chunk->errors++;
+            chunk->trace.swap(chunkTrace.buffer);
+            if constexpr (METRICS_ENABLED) {
+                chunk->counters = ctx.counters;
+                ctx.counters = ParseCounters();
+            }
+            chunk->diag = diag.str();
 
-    printTableHeader();
-    displayStack(st, input, pos, "Initial state");
+            {
+                lock_guard<mutex> lock(m);
+                chunk->done = true;
+            }
+            chunkDone.notify_all();
+        }
+    };
 
-    while (!st.empty() && errStreak < MAX_ERR)
-    {
-        string top = st.top();  string act;
+    vector<thread> pool;
+    for (unsigned i = 0; i < workers; ++i) pool.emplace_back(worker);
+
+    deque<unique_ptr<LineChunk>> inFlight;   // in input order
+    int totalErrors = 0;
 
-        if (top == la) {
-            if (top == "$") { act = "ACCEPT"; st.pop(); displayStack(st,input,pos,act); break; }
-            st.pop(); act = "Match '" + top + "'"; la = getNextToken(input,pos); errStreak = 0;
+    auto flushFront = [&]() {
+        LineChunk* front = inFlight.front().get();
+        {
+            unique_lock<mutex> lock(m);
+            chunkDone.wait(lock, [&] { return front->done; });
         }
-        else if (isTerminal(top)) {
-            hadErr = true; act = "Error: expected '" + top + "'";
-            st.pop(); la = getNextToken(input,pos); errStreak++;
+        out.writeBuffer(front->trace);
+        cerr << front->diag;
+        totalErrors += front->errors;
+        if constexpr (METRICS_ENABLED) metrics.parse.add(front->counters);
+        inFlight.pop_front();
+    };
+
+    auto submit = [&](unique_ptr<LineChunk> chunk) {
+        {
+            lock_guard<mutex> lock(m);
+            queue.push_back(chunk.get());
         }
-        else if (isNonTerminal(top)) {
-            if (parseTable.count({top, la})) {
-                vector<string> prod = parseTable[{top, la}]; st.pop();
-                if (!(prod.size()==1 && prod[0]=="epsilon"))
-                    for (int i=static_cast<int>(prod.size())-1;i>=0;--i) st.push(prod[i]);
-                act = top + " → "; for (auto&s:prod) act+=s+" "; errStreak=0;
-            } else {
-                hadErr = true; act = "Error: no rule for ("+top+", "+la+")";
-                la = getNextToken(input,pos); errStreak++;
-            }
-        } else { cerr<<"Internal parser error.\n"; return false; }
+        workReady.notify_one();
+        inFlight.push_back(move(chunk));
+        while (inFlight.size() >= WINDOW * workers) flushFront();
+    };
 
-        displayStack(st,input,pos,act);
+    unique_ptr<LineChunk> chunk(new LineChunk);
+    string_view line;  int lineNo = 0;
+    while (in.nextLine(line))
+    {
+        lineNo++;
+        if (line.empty() || line[0] == '#') continue;
+        /* mapped lines stay valid for the whole run; buffered ones don't */
+        if (!in.isMapped()) {
+            chunk->copies.emplace_back(line);
+            line = chunk->copies.back();
+        }
+        chunk->lines.push_back({lineNo, line});
+        if constexpr (METRICS_ENABLED) pollMetrics();
+        if (chunk->lines.size() == LINES_PER_CHUNK) {
+            submit(move(chunk));
+            chunk.reset(new LineChunk);
+        }
     }
+    if (!chunk->lines.empty()) submit(move(chunk));
 
-    if (errStreak>=MAX_ERR) {
-        cout<<"Too many consecutive errors – giving up on line "<<lineNumber<<".\n";
-        if (outputFile.is_open())
-            outputFile<<"Too many consecutive errors – giving up on line "<<lineNumber<<".\n";
-        return false;
-    }
-    return !hadErr;
-}
+    while (!inFlight.empty()) flushFront();
 
-/*  getNextToken & main() unchanged – see previous file  */
+    {
+        lock_guard<mutex> lock(m);
+        noMoreWork = true;
+    }
+    workReady.notify_all();
+    for (auto& t : pool) t.join();
 
+    return totalErrors;
+}
 
 /* -----------------------------------------------------------------
-   ──────────────  Tokeniser (unchanged)  ──────────────
+   ───────  parseString  ───────
+   Dispatches once on the sink's level; inside runParse<Level> every
+   trace statement above Level is discarded at compile time, so a quiet
+   run does no formatting, copying or I/O per step.
 ------------------------------------------------------------------*/
+bool CFGProcessor::parseString(const string& input, int lineNumber)
+{
+    mainContext.out = trace;  mainContext.diag = &cerr;
+    switch (trace->level) {
+        case TRACE_NONE:    return runParse<TRACE_NONE>(input, lineNumber, mainContext);
+        case TRACE_ERRORS:  return runParse<TRACE_ERRORS>(input, lineNumber, mainContext);
+        case TRACE_SUMMARY: return runParse<TRACE_SUMMARY>(input, lineNumber, mainContext);
+        default:            return runParse<TRACE_FULL>(input, lineNumber, mainContext);
+    }
+}
 
-string CFGProcessor::getNextToken(const string& input, int& position)
+bool CFGProcessor::parseInto(string_view input, int lineNumber, ParseContext& ctx) const
 {
-    while (position < static_cast<int>(input.length()) &&
-           isspace(static_cast<unsigned char>(input[position])))
-        ++position;
+    static NullTrace quiet;
+    ctx.out = &quiet;
+    return ctx.errors ? runParse<TRACE_ERRORS>(input, lineNumber, ctx)
+                      : runParse<TRACE_NONE>(input, lineNumber, ctx);
+}
 
-    if (position >= static_cast<int>(input.length())) return "$";
+/* Lex the whole line once; the driver only walks the token array */
+template <TraceLevel Level>
+bool CFGProcessor::runParse(string_view input, int lineNumber, ParseContext& ctx) const
+{
+    lexer.tokenize(input, ctx.tokens, *ctx.diag);
+    TokenArray tokens(ctx.tokens, input, lineNumber);
+    return drive<Level>(tokens, ctx);
+}
 
-    char c = input[position];
+template bool CFGProcessor::runParse<TRACE_NONE>(string_view, int, ParseContext&) const;   // parseTree.cpp
 
-    /* single-char tokens */
-    string one(1, c);
-    const string singles = "(){}`;=+-*/";
-    if (singles.find(c) != string::npos) { ++position; return one; }
+constexpr uint64_t POLL_TOKENS = 4096;         // tokens between SIGUSR1 checks inside one parse
 
-    /* two-char operators */
-    if ((c == '=' || c == '!' || c == '<' || c == '>') &&
-        position + 1 < static_cast<int>(input.length()) &&
-        input[position + 1] == '=') {
-        position += 2;
-        return input.substr(position - 2, 2);
+template <TraceLevel Level, class Input>
+bool CFGProcessor::drive(Input& in, ParseContext& ctx) const
+{
+    const SymbolTable& sym = grammar.symbols;
+    TraceSink& out = *ctx.out;
+    SymbolStack& st = ctx.stack;
+    st.reserve(stackReserve);
+    st.clear();  st.push_back(grammar.endMarker);  st.push_back(grammar.startSymbol);
+    Symbol la = in.token().terminal;
+
+    /* Tree mode: ctx.nodes shadows the stack with each entry's node */
+    Arena* arena = ctx.treeArena;
+    vector<TreeNode*>& nodes = ctx.nodes;
+    if (arena) {
+        TreeNode* root = arena->allocate<TreeNode>();
+        *root = {grammar.startSymbol, NO_PRODUCTION, in.token().offset, 0, nullptr, 0};
+        ctx.tree = root;
+        nodes.clear();  nodes.push_back(nullptr);  nodes.push_back(root);
     }
+    /* Steps and stack growth since the last token was consumed.  A legal
+       parse stays within both limits; past them a conflict is cycling on
+       this token, so the stack goes back to where it was and the token is
+       dropped.  That keeps the work per token bounded. */
+    size_t idle = 0, base = st.size(), idleLimit, growthLimit;
+    auto limitFrom = [&]() {
+        idleLimit = (base + 1) * (sym.numNonTerminals() + 1) + maxIdleGrowth;
+        growthLimit = base + maxIdleGrowth;
+    };
+    limitFrom();
+
+    /* Counted locally, added to the context's totals on the way out */
+    ParseCounters n;
+    n.maxStackDepth = st.size();
+
+    /* SIGUSR1 between lines is handled by the file loops; a single long
+       sentence (--whole-file) also checks every POLL_TOKENS tokens, and
+       its snapshot includes the counts so far */
+    const bool pollSignal = METRICS_ENABLED && &ctx == &mainContext && !metricsPath.empty();
+    uint64_t consumed = 0;
+    auto advance = [&]() {
+        in.advance();
+        la = in.token().terminal;
+        idle = 0;  base = st.size();
+        limitFrom();
+        if constexpr (METRICS_ENABLED) {
+            if (pollSignal && ++consumed % POLL_TOKENS == 0 && takeMetricsRequest()) {
+                ParseCounters running = n;
+                running.lines = in.lines();  running.tokensLexed = in.lexed();
+                writeMetrics(&running);
+            }
+        }
+    };
+    auto stuck = [&]() { return ++idle > idleLimit || st.size() > growthLimit; };
+
+    bool hadErr = false;
+
+    auto finish = [&](bool ok) {
+        if constexpr (METRICS_ENABLED) {
+            n.lines = in.lines();  n.linesWithErrors = !ok;  n.tokensLexed = in.lexed();
+            ctx.counters.add(n);
+        }
+        return ok;
+    };
 
-    /* standalone < or > */
-    if (c == '<' || c == '>') { ++position; return one; }
-
-    /* identifiers / keywords */
-    if (isalpha(c) || c == '_') {
-        int start = position;
-        while (position < static_cast<int>(input.length()) &&
-               (isalnum(input[position]) || input[position] == '_'))
-            ++position;
-        string tok = input.substr(start, position - start);
-        if (grammar.terminals.count(tok)) return tok;   // keyword
-        if (tok == "int" || tok == "if")    return tok; // hard-coded kw
-        return "id";
+    /* In full mode errors already show up as table rows */
+    auto reportError = [&](const string& msg) {
+        if (ctx.errors)
+            ctx.errors->push_back({in.line(), static_cast<int>(in.token().offset + 1), msg});
+        else if (Level == TRACE_ERRORS || Level == TRACE_SUMMARY)
+            out.write("Line " + to_string(in.line()) + ", col " +
+                      to_string(in.token().offset + 1) + ": " + msg + "\n");
+    };
+
+    if constexpr (Level >= TRACE_FULL) {
+        printTableHeader(out);
+        displayStack(ctx, in.rest(lexer), "Initial state");
     }
 
-    /* integer literals */
-    if (isdigit(c)) {
-        while (position < static_cast<int>(input.length()) &&
-               isdigit(input[position])) ++position;
-        return grammar.terminals.count("int_lit") ? "int_lit"
-                                                  : input.substr(position, 1);
+    /* Panic mode drops the lookahead; each drop is its own trace row */
+    auto skipToken = [&]() {
+        string act;
+        if constexpr (Level >= TRACE_FULL) act = "Skip '" + string(lexer.text(in.token(), in.source())) + "'";
+        if constexpr (METRICS_ENABLED) n.recoverySkips++;
+        advance();
+        if constexpr (Level >= TRACE_FULL) displayStack(ctx, in.rest(lexer), act);   // the input after the skip, like Match
+    };
+
+    const StackAction* actions = stackActions.data();
+    while (!st.empty())
+    {
+        Symbol top = st.back();  string act;
+        if constexpr (METRICS_ENABLED) {
+            n.parseSteps++;
+            n.stackDepthSum += st.size();
+        }
+
+        if (stuck()) {
+            hadErr = true;
+            if constexpr (Level >= TRACE_ERRORS) {
+                act = "Error: no progress at '" + string(lexer.text(in.token(), in.source())) + "'";
+                reportError(act);
+            }
+            if (st.size() > base) {
+                st.truncate(base);
+                if (arena) nodes.resize(base);
+            }
+            if constexpr (Level >= TRACE_FULL) displayStack(ctx, in.rest(lexer), act);
+            if (la == grammar.endMarker) break;
+            skipToken();
+            continue;
+        }
+
+        /* One switch on the action precomputed for the top symbol
+           (stackActions); the kind of symbol is never worked out here */
+        switch (actions[top]) {
+        case ACT_MATCH:
+            if (top == la) {
+                st.pop_back();
+                if (arena) {
+                    TreeNode* leaf = nodes.back();  nodes.pop_back();
+                    leaf->offset = in.token().offset;  leaf->length = in.token().length;
+                }
+                if constexpr (Level >= TRACE_FULL) act = "Match '" + sym.name(top) + "'";
+                if constexpr (METRICS_ENABLED) n.matches++;
+                advance();
+            }
+            else {
+                /* Missing terminal: pop it as if it had been there */
+                hadErr = true;
+                if constexpr (Level >= TRACE_ERRORS) {
+                    act = "Error: expected '" + sym.name(top) + "'";
+                    reportError(act);
+                }
+                st.pop_back(); if (arena) nodes.pop_back();
+                if constexpr (METRICS_ENABLED) n.recoverySkips++;
+            }
+            break;
+
+        case ACT_ACCEPT:
+            if (la == grammar.endMarker) {
+                st.pop_back();
+                if constexpr (Level >= TRACE_FULL) displayStack(ctx, in.rest(lexer), "ACCEPT");
+                return finish(!hadErr);
+            }
+            else {
+                /* A complete sentence with input left over: skip to where the
+                   start symbol can begin again and parse the rest as another */
+                hadErr = true;
+                if constexpr (Level >= TRACE_ERRORS) {
+                    act = "Error: unexpected '" + string(lexer.text(in.token(), in.source())) +
+                          "' after a complete " + sym.name(grammar.startSymbol);
+                    reportError(act);
+                }
+                if constexpr (Level >= TRACE_FULL) displayStack(ctx, in.rest(lexer), act);
+                while (la != grammar.endMarker && (la == NO_SYMBOL || predict(grammar.startSymbol, la) == NO_PRODUCTION))
+                    skipToken();
+                if (la == grammar.endMarker) continue;
+                st.push_back(grammar.startSymbol);
+                if (arena) {
+                    /* parsed, but only the first sentence is in the tree */
+                    TreeNode* extra = arena->allocate<TreeNode>();
+                    *extra = {grammar.startSymbol, NO_PRODUCTION, in.token().offset, 0, nullptr, 0};
+                    nodes.push_back(extra);
+                }
+                if constexpr (Level >= TRACE_FULL) act = "Restart " + sym.name(grammar.startSymbol);
+            }
+            break;
+
+        case ACT_EXPAND: {
+            int p = (la == NO_SYMBOL) ? NO_PRODUCTION : predict(top, la);
+            if constexpr (METRICS_ENABLED) n.tableLookups += (la != NO_SYMBOL);
+            if (p != NO_PRODUCTION) {
+                const Symbol* push = pushFrom[p];
+                const int count = pushStart[p + 1] - pushStart[p];
+                st.pop_back();  st.push(push, count);
+                if constexpr (METRICS_ENABLED) {
+                    n.expansions++;
+                    if (st.size() > n.maxStackDepth) n.maxStackDepth = st.size();
+                }
+                if (arena) {
+                    /* children come out of the arena as one span */
+                    TreeNode* node = nodes.back();  nodes.pop_back();
+                    node->production = p;
+                    if (count) {
+                        node->childCount = count;
+                        node->children = arena->allocate<TreeNode>(count);
+                        for (int i=0;i<count;++i)
+                            node->children[i] = {push[count-1-i], NO_PRODUCTION, in.token().offset, 0, nullptr, 0};
+                        for (int i=count-1;i>=0;--i) nodes.push_back(&node->children[i]);
+                    }
+                }
+                if constexpr (Level >= TRACE_FULL) act = productionText(p, " → ");
+            } else {
+                /* Panic mode: skip to a token that can start top (and go on
+                   expanding it) or that is in its sync set (pop it) */
+                hadErr = true;
+                if constexpr (Level >= TRACE_ERRORS) {
+                    act = "Error: no rule for ("+sym.name(top)+", "+string(lexer.text(in.token(), in.source()))+")";
+                    reportError(act);
+                }
+                if constexpr (Level >= TRACE_FULL) displayStack(ctx, in.rest(lexer), act);
+                const TerminalSet& sync = syncSets[top - sym.numTerminals];
+                while (la == NO_SYMBOL || (predict(top, la) == NO_PRODUCTION && !sync.contains(la)))
+                    skipToken();
+                if (predict(top, la) != NO_PRODUCTION) continue;
+                st.pop_back(); if (arena) nodes.pop_back();
+                if constexpr (METRICS_ENABLED) n.recoverySkips++;
+                if constexpr (Level >= TRACE_FULL) act = "Pop " + sym.name(top) + " (sync)";
+            }
+            break;
+        }
+        }
+
+        if constexpr (Level >= TRACE_FULL) displayStack(ctx, in.rest(lexer), act);
     }
 
-    /* unknown char */
-    ++position;
-    cerr << "Warning: unrecognised char '" << c << "'\n";
-    return one;
+    return finish(!hadErr);
 }
 
 /* -----------------------------------------------------------------
-   ──────────────  Main  ──────────────
+   ──────────────  Tokeniser  ──────────────
+   The real work lives in Lexer (lexer.cpp), which lexes a whole line
+   into a token array up front.  This is the old one-token-at-a-time
+   interface on top of it.
 ------------------------------------------------------------------*/
 
-int main(int argc, char* argv[])
+string CFGProcessor::getNextToken(const string& input, int& position)
 {
-    if (argc != 4) {
-        cerr << "Usage: " << argv[0]
-             << " grammar.txt input.txt output.txt\n";
-        return 1;
-    }
-
-    CFGProcessor proc(argv[1], argv[3]);
-    proc.displayResults();           // grammar → FIRST/FOLLOW/table
-    proc.parseInputFile(argv[2]);    // now parse the supplied strings
-
-    cout << "\nProcessing complete.  Results written to " << argv[3] << '\n';
-    if (proc.outputFile.is_open())
-        proc.outputFile << "\nProcessing complete.\n";
-    return 0;
+    size_t pos = position;
+    Token tok = lexer.next(input, pos, cerr);
+    position = static_cast<int>(pos);
+    if (tok.length == 0) return "$";
+    return string(lexer.text(tok, input));
 }
@@ -0,0 +1,62 @@
+#include "sourceCFG.h"
+
+using namespace std;
+
+
+void flattenPreorder(const TreeNode* root, vector<PreorderNode>& out)
+{
+    // Explicit stack: right-recursive list rules make trees very deep
+    vector<const TreeNode*> pending;
+    pending.push_back(root);
+    while (!pending.empty()) {
+        const TreeNode* node = pending.back();
+        pending.pop_back();
+        out.push_back({node->symbol, node->production, node->offset, node->length, node->childCount});
+        for (uint32_t i = node->childCount; i > 0; i--) {
+            pending.push_back(&node->children[i - 1]);
+        }
+    }
+}
+
+bool CFGProcessor::parseTree(string_view input, int lineNumber, Arena& arena, TreeNode*& root)
+{
+    ParseContext& ctx = mainContext;
+    TraceSink* saved = ctx.out;
+    StringTrace quiet(TRACE_NONE);
+    ctx.out = &quiet;
+    ctx.treeArena = &arena;
+    bool ok = runParse<TRACE_NONE>(input, lineNumber, ctx);
+    ctx.treeArena = nullptr;
+    ctx.out = saved;
+    root = ctx.tree;
+    return ok;
+}
+
+// Indented outline, one node per line: non-terminals by name, terminals
+// with their lexeme ("<missing>" where the parse expected one and failed)
+string CFGProcessor::treeText(const TreeNode* root, string_view source) const
+{
+    string text;
+    vector<pair<const TreeNode*, int>> pending;     // (node, depth)
+    pending.push_back({root, 1});
+    while (!pending.empty()) {
+        const TreeNode* node = pending.back().first;
+        int depth = pending.back().second;
+        pending.pop_back();
+
+        text += string(2 * depth, ' ') + grammar.symbols.name(node->symbol);
+        if (isTerminal(node->symbol)) {
+            text += node->length ? "  '" + string(source.substr(node->offset, node->length)) + "'"
+                                 : string("  <missing>");
+        }
+        else if (node->production == NO_PRODUCTION) {
+            text += "  <missing>";
+        }
+        text += "\n";
+
+        for (uint32_t i = node->childCount; i > 0; i--) {
+            pending.push_back({&node->children[i - 1], depth + 1});
+        }
+    }
+    return text;
+}
@@ -0,0 +1,38 @@
+#ifndef PARSE_TREE_H
+#define PARSE_TREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "arena.h"
+#include "grammar.h"
+
+/* ——— Concrete syntax tree ———
+   Built by the parse driver as it expands productions and matches
+   terminals.  Every node lives in an Arena, and the children of a node
+   are allocated together when its production is expanded, so they are
+   one contiguous span rather than a per-node vector.  The tree is only
+   valid until that arena is reset.                                    */
+struct TreeNode {
+    Symbol symbol;
+    int production;          // non-terminals: production expanded, NO_PRODUCTION (-1) if never reached
+    uint32_t offset;         // terminals: the matched token; non-terminals: where they started
+    uint32_t length;         // terminals: token length, 0 if missing (syntax error); non-terminals: 0
+    TreeNode* children;
+    uint32_t childCount;
+};
+
+/* The same tree as a flat preorder array: a node is followed by its
+   children's subtrees in order, so childCount is enough to walk it.   */
+struct PreorderNode {
+    Symbol symbol;
+    int production;
+    uint32_t offset;
+    uint32_t length;
+    uint32_t childCount;
+};
+
+// Append root's subtree to out in preorder
+void flattenPreorder(const TreeNode* root, std::vector<PreorderNode>& out);
+
+#endif   // PARSE_TREE_H
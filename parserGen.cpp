@@ -0,0 +1,321 @@
+#include "sourceCFG.h"
+
+#include <cstdio>
+using namespace std;
+
+
+/* ——— Parser generator ———
+   Writes the finished parse table out as a standalone C++17 header: symbol
+   enums, constexpr tables and either the usual table-driven loop or one
+   recursive-descent function per non-terminal.  The header also carries a
+   tokenizer with the same rules as lexer.cpp, so a generated parser
+   accepts exactly the lines parseString accepts, with no grammar
+   processing at runtime.  It only reports accept/reject; there's no
+   trace or error recovery.                                            */
+
+bool parseEmitStyle(const string& name, EmitStyle& style)
+{
+    if (name == "table") { style = EMIT_TABLE;  return true; }
+    if (name == "rd")    { style = EMIT_RD;     return true; }
+    return false;
+}
+
+// Readable identifier text for a symbol name
+static string identifierFor(const string& name)
+{
+    static const map<string, string> punctuation = {
+        {"(", "LPAREN"}, {")", "RPAREN"}, {"{", "LBRACE"}, {"}", "RBRACE"},
+        {";", "SEMI"}, {"=", "ASSIGN"}, {"+", "PLUS"}, {"-", "MINUS"},
+        {"*", "STAR"}, {"/", "SLASH"}, {"<", "LT"}, {">", "GT"},
+        {"==", "EQ"}, {"!=", "NE"}, {"<=", "LE"}, {">=", "GE"},
+        {"`", "BACKTICK"}, {"$", "END"}, {"epsilon", "EPSILON"},
+    };
+    auto it = punctuation.find(name);
+    if (it != punctuation.end()) return it->second;
+
+    string id;
+    for (int i = 0; i < name.size(); i++) {
+        unsigned char c = name[i];
+        if (isalnum(c) || c == '_') id += c;
+        else if (c == '\'') id += "_p";        // E' -> E_p
+        else id += '_';
+    }
+    return id;
+}
+
+// C++ string literal for a symbol name
+static string quoted(const string& text)
+{
+    string out = "\"";
+    for (int i = 0; i < text.size(); i++) {
+        unsigned char c = text[i];
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (c < 0x20 || c >= 0x7f) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\%03o", c);
+            out += buf;
+        }
+        else out += c;
+    }
+    return out + "\"";
+}
+
+// Comma-separated values, a fixed number per line
+template <class T>
+static void writeArray(ostream& out, const vector<T>& values, int perLine)
+{
+    for (int i = 0; i < values.size(); i++) {
+        if (i % perLine == 0) out << "\n    ";
+        out << values[i] << ",";
+        if (i % perLine != perLine - 1 && i + 1 < values.size()) out << " ";
+    }
+    out << "\n";
+}
+
+bool CFGProcessor::emitParser(const string& headerPath, EmitStyle style) const
+{
+    const SymbolTable& sym = grammar.symbols;
+    const int numTerminals = sym.numTerminals;
+
+    // Namespace and include guard come from the file name
+    size_t slash = headerPath.find_last_of("/\\");
+    string base = headerPath.substr(slash == string::npos ? 0 : slash + 1);
+    base = base.substr(0, base.find('.'));
+    string ns = identifierFor(base);
+    if (ns.empty() || isdigit(static_cast<unsigned char>(ns[0]))) ns = "parser_" + ns;
+    string guard = ns;
+    for (int i = 0; i < guard.size(); i++) guard[i] = toupper(static_cast<unsigned char>(guard[i]));
+    guard += "_H";
+
+    // Enumerator names: T_/N_ prefix, suffixed with the id on a clash
+    vector<string> names(sym.size());
+    set<string> taken;
+    for (Symbol s = 0; s < sym.size(); s++) {
+        string id = (isTerminal(s) ? "T_" : "N_") + identifierFor(sym.name(s));
+        if (!taken.insert(id).second) {
+            id += "_" + to_string(s);
+            taken.insert(id);
+        }
+        names[s] = id;
+    }
+
+    auto terminalOrNone = [&](const string& name) {
+        Symbol s = sym.find(name);
+        return isTerminal(s) ? names[s] : string("NO_TERMINAL");
+    };
+
+    // Right-hand sides reversed for pushing, as the driver pushes them
+    vector<int> prodStart, prodLength, rhs;
+    for (int p = 0; p < productionArena.size(); p++) {
+        prodStart.push_back(rhs.size());
+        prodLength.push_back(pushStart[p + 1] - pushStart[p]);
+        rhs.insert(rhs.end(), pushFrom[p], pushFrom[p] + prodLength.back());
+    }
+
+    ofstream out(headerPath);
+    if (!out.is_open()) return false;
+
+    const char* cellType = productionArena.size() < 32767 ? "int16_t" : "int32_t";
+
+    out << "// Generated LL(1) parser for " << grammarFile << " -- do not edit.\n"
+        << "// Regenerate with: app <grammar> <input> <output> --emit-parser=" << headerPath << "\n"
+        << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+        << "#include <cstddef>\n#include <cstdint>\n#include <string_view>\n#include <vector>\n\n"
+        << "namespace " << ns << " {\n\n";
+
+    /* —— Symbols —— */
+    out << "// Terminals, in name order (the tokenizer binary-searches TERMINAL_NAMES)\n"
+        << "enum Terminal : int {\n";
+    for (Symbol t = 0; t < numTerminals; t++) {
+        out << "    " << names[t] << " = " << t << ",\n";
+    }
+    out << "    NO_TERMINAL = -1\n};\n\n";
+
+    out << "enum NonTerminal : int {\n";
+    for (Symbol nt = numTerminals; nt < sym.size(); nt++) {
+        out << "    " << names[nt] << " = " << nt << ",\n";
+    }
+    out << "};\n\n";
+
+    out << "constexpr int NUM_TERMINALS = " << numTerminals << ";\n"
+        << "constexpr int NUM_SYMBOLS = " << sym.size() << ";\n"
+        << "constexpr int START = " << names[grammar.startSymbol] << ";\n"
+        << "constexpr int END_MARKER = " << names[grammar.endMarker] << ";\n\n";
+
+    out << "constexpr std::string_view SYMBOL_NAMES[NUM_SYMBOLS] = {";
+    vector<string> literals;
+    for (Symbol s = 0; s < sym.size(); s++) literals.push_back(quoted(sym.name(s)));
+    writeArray(out, literals, 8);
+    out << "};\n"
+        << "constexpr const std::string_view* TERMINAL_NAMES = SYMBOL_NAMES;\n\n";
+
+    /* —— Tables —— */
+    out << "// Production per [non-terminal][terminal], -1 = error\n"
+        << "constexpr " << cellType << " TABLE[" << max<size_t>(parseTable.size(), 1) << "] = {";
+    writeArray(out, parseTable, numTerminals);
+    out << "};\n\n";
+
+    out << "// Right-hand side of production p, reversed: RHS[PROD_START[p] ...]\n"
+        << "constexpr int PROD_START[" << max<size_t>(prodStart.size(), 1) << "] = {";
+    writeArray(out, prodStart, 16);
+    out << "};\nconstexpr int PROD_LENGTH[" << max<size_t>(prodLength.size(), 1) << "] = {";
+    writeArray(out, prodLength, 16);
+    out << "};\nconstexpr int RHS[" << max<size_t>(rhs.size(), 1) << "] = {";
+    writeArray(out, rhs, 16);
+    out << "};\n\n";
+
+    /* —— Tokenizer (same rules as lexer.cpp) —— */
+    vector<string> charTerminal(256, "NO_TERMINAL");
+    for (int c = 0; c < 256; c++) charTerminal[c] = terminalOrNone(string(1, static_cast<char>(c)));
+
+    out << "struct Token {\n"
+           "    int terminal;        // NO_TERMINAL if the grammar has no such terminal\n"
+           "    uint32_t offset;\n"
+           "    uint32_t length;\n"
+           "};\n\n"
+        << "constexpr int ID = " << terminalOrNone("id") << ";\n"
+        << "constexpr int INT_LITERAL = " << terminalOrNone("int_lit") << ";\n"
+        << "constexpr int CHAR_TERMINAL[256] = {";
+    writeArray(out, charTerminal, 8);
+    out << "};\n\n";
+
+    out << R"(inline int lookupTerminal(std::string_view word) {
+    int lo = 0, hi = NUM_TERMINALS;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (TERMINAL_NAMES[mid] < word) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < NUM_TERMINALS && TERMINAL_NAMES[lo] == word) ? lo : NO_TERMINAL;
+}
+
+inline bool isBlank(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+inline bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Lex a line; the last token is always END_MARKER with length 0
+inline void tokenize(std::string_view text, std::vector<Token>& out) {
+    out.clear();
+    size_t pos = 0;
+    while (true) {
+        while (pos < text.size() && isBlank(text[pos])) ++pos;
+        const uint32_t start = static_cast<uint32_t>(pos);
+        if (pos >= text.size()) {
+            out.push_back({END_MARKER, start, 0});
+            return;
+        }
+        const unsigned char c = text[pos];
+        if ((c == '=' || c == '!' || c == '<' || c == '>') &&
+            pos + 1 < text.size() && text[pos + 1] == '=') {
+            pos += 2;
+            out.push_back({lookupTerminal(text.substr(start, 2)), start, 2});
+        }
+        else if (isAlpha(c) || c == '_') {
+            while (pos < text.size() && (isAlpha(text[pos]) || isDigit(text[pos]) || text[pos] == '_')) ++pos;
+            std::string_view word = text.substr(start, pos - start);
+            int keyword = lookupTerminal(word);
+            if (keyword == NO_TERMINAL && word != "int" && word != "if") keyword = ID;
+            out.push_back({keyword, start, static_cast<uint32_t>(pos - start)});
+        }
+        else if (isDigit(c)) {
+            while (pos < text.size() && isDigit(text[pos])) ++pos;
+            out.push_back({INT_LITERAL, start, static_cast<uint32_t>(pos - start)});
+        }
+        else {
+            ++pos;
+            out.push_back({CHAR_TERMINAL[c], start, 1});
+        }
+    }
+}
+
+)";
+
+    /* —— Parser —— */
+    if (style == EMIT_TABLE) {
+        out << R"(// Table-driven LL(1) loop over a token array ending in END_MARKER
+inline bool parse(const Token* tokens, size_t count) {
+    thread_local std::vector<int> stack;
+    stack.clear();
+    stack.push_back(END_MARKER);
+    stack.push_back(START);
+    size_t cur = 0;
+    while (true) {
+        const int top = stack.back();
+        const int la = tokens[cur].terminal;
+        if (top == la) {
+            if (top == END_MARKER) return true;
+            stack.pop_back();
+            if (cur + 1 < count) ++cur;
+            continue;
+        }
+        if (top < NUM_TERMINALS || la == NO_TERMINAL) return false;
+        const int p = TABLE[(top - NUM_TERMINALS) * NUM_TERMINALS + la];
+        if (p < 0) return false;
+        stack.pop_back();
+        stack.insert(stack.end(), RHS + PROD_START[p], RHS + PROD_START[p] + PROD_LENGTH[p]);
+    }
+}
+)";
+    }
+    else {
+        out << R"(// Recursive descent: one function per non-terminal
+struct Cursor {
+    const Token* tokens;
+    size_t cur;
+    size_t count;
+
+    int peek() const { return tokens[cur].terminal; }
+    bool match(int terminal) {
+        if (tokens[cur].terminal != terminal) return false;
+        if (cur + 1 < count) ++cur;
+        return true;
+    }
+};
+
+)";
+        for (Symbol nt = numTerminals; nt < sym.size(); nt++) {
+            out << "inline bool parse_" << names[nt] << "(Cursor& c);\n";
+        }
+        out << "\n";
+
+        for (Symbol nt = numTerminals; nt < sym.size(); nt++) {
+            out << "inline bool parse_" << names[nt] << "(Cursor& c) {\n"
+                << "    switch (c.peek()) {\n";
+
+            // One case group per production, listing the terminals predicting it
+            for (int p = 0; p < productionArena.size(); p++) {
+                if (productionArena[p].lhs != nt) continue;
+                string labels;
+                for (Symbol t = 0; t < numTerminals; t++) {
+                    if (tableCell(nt, t) == p) labels += "    case " + names[t] + ":\n";
+                }
+                if (labels.empty()) continue;
+
+                string body;
+                for (int i = prodLength[p] - 1; i >= 0; i--) {
+                    Symbol s = rhs[prodStart[p] + i];
+                    if (!body.empty()) body += " && ";
+                    body += isTerminal(s) ? "c.match(" + names[s] + ")" : "parse_" + names[s] + "(c)";
+                }
+                out << labels << "        return " << (body.empty() ? "true" : body) << ";\n";
+            }
+            out << "    default:\n        return false;\n    }\n}\n\n";
+        }
+
+        out << "inline bool parse(const Token* tokens, size_t count) {\n"
+            << "    Cursor c{tokens, 0, count};\n"
+            << "    return parse_" << names[grammar.startSymbol] << "(c) && c.peek() == END_MARKER;\n"
+            << "}\n";
+    }
+
+    out << R"(
+inline bool parse(std::string_view line) {
+    thread_local std::vector<Token> tokens;
+    tokenize(line, tokens);
+    return parse(tokens.data(), tokens.size());
+}
+
+}   // namespace )" << ns << "\n\n#endif   // " << guard << "\n";
+
+    return out.good();
+}
@@ -0,0 +1,250 @@
+#include "registry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace std;
+
+
+namespace {
+
+// Modification time and size, to notice a changed file without reading it
+bool fileStamp(const string& path, int64_t& mtime, int64_t& size)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    size = st.st_size;
+    return true;
+}
+
+bool readFile(const string& path, string& text, string* error)
+{
+    ifstream in(path, ios::binary);
+    if (!in) {
+        if (error) *error = "Error opening file: " + path;
+        return false;
+    }
+    ostringstream buffer;
+    buffer << in.rdbuf();
+    text = buffer.str();
+    return true;
+}
+
+}
+
+GrammarRegistry::GrammarRegistry() : entries(make_shared<const Snapshot>()), pool(make_shared<GrammarPool>()) {}
+
+GrammarRegistry::~GrammarRegistry()
+{
+    {
+        lock_guard<mutex> lock(watching);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (watcher.joinable()) watcher.join();
+}
+
+shared_ptr<const GrammarRegistry::Snapshot> GrammarRegistry::snapshot() const
+{
+    return atomic_load_explicit(&entries, memory_order_acquire);
+}
+
+// An already-compiled parser for the same text, or a fresh compile (outside the lock)
+shared_ptr<const CompiledParser> GrammarRegistry::compiled(string_view text, size_t hash, string* error)
+{
+    {
+        lock_guard<mutex> lock(writing);
+        auto range = byText.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            shared_ptr<const GrammarVersion> v = it->second.lock();
+            if (v && v->text == text) return v->parser;
+        }
+    }
+    return CompiledParser::compile(text, error, pool);
+}
+
+shared_ptr<const GrammarVersion> GrammarRegistry::publish(const string& name, string_view text, string* error)
+{
+    shared_ptr<const GrammarVersion> current = find(name);
+    if (current && current->text == text) return current;
+
+    size_t hash = std::hash<string_view>()(text);
+    shared_ptr<const CompiledParser> parser = compiled(text, hash, error);
+    if (!parser) return nullptr;
+
+    lock_guard<mutex> lock(writing);
+    auto next = make_shared<Snapshot>(*snapshot());
+    Entry& entry = (*next)[name];
+    if (entry.current && entry.current->text == text) return entry.current;   // lost a race to the same text
+
+    auto version = make_shared<GrammarVersion>();
+    version->name = name;
+    version->version = ++lastVersion[name];
+    version->text = string(text);
+    version->parser = parser;
+
+    if (entry.current) {
+        auto expired = [](const weak_ptr<const GrammarVersion>& w) { return w.expired(); };
+        entry.older.erase(remove_if(entry.older.begin(), entry.older.end(), expired), entry.older.end());
+        entry.older.push_back(entry.current);
+    }
+    entry.current = version;
+
+    auto range = byText.equal_range(hash);
+    for (auto it = range.first; it != range.second; ) {
+        if (it->second.expired()) it = byText.erase(it);
+        else ++it;
+    }
+    byText.emplace(hash, version);
+
+    atomic_store_explicit(&entries, shared_ptr<const Snapshot>(move(next)), memory_order_release);
+    return version;
+}
+
+bool GrammarRegistry::remove(const string& name)
+{
+    lock_guard<mutex> lock(writing);
+    shared_ptr<const Snapshot> current = snapshot();
+    if (!current->count(name)) return false;
+    auto next = make_shared<Snapshot>(*current);
+    next->erase(name);
+    atomic_store_explicit(&entries, shared_ptr<const Snapshot>(move(next)), memory_order_release);
+    return true;
+}
+
+shared_ptr<const GrammarVersion> GrammarRegistry::find(const string& name) const
+{
+    shared_ptr<const Snapshot> current = snapshot();
+    auto it = current->find(name);
+    return it == current->end() ? nullptr : it->second.current;
+}
+
+shared_ptr<const GrammarVersion> GrammarRegistry::find(const string& name, uint64_t version) const
+{
+    shared_ptr<const Snapshot> current = snapshot();
+    auto it = current->find(name);
+    if (it == current->end()) return nullptr;
+    if (it->second.current->version == version) return it->second.current;
+    for (const weak_ptr<const GrammarVersion>& w : it->second.older) {
+        shared_ptr<const GrammarVersion> v = w.lock();
+        if (v && v->version == version) return v;
+    }
+    return nullptr;
+}
+
+vector<string> GrammarRegistry::names() const
+{
+    shared_ptr<const Snapshot> current = snapshot();
+    vector<string> result;
+    for (const auto& entry : *current) result.push_back(entry.first);
+    sort(result.begin(), result.end());
+    return result;
+}
+
+size_t GrammarRegistry::compiledCount() const
+{
+    lock_guard<mutex> lock(writing);
+    set<const CompiledParser*> parsers;
+    for (const auto& entry : byText) {
+        if (shared_ptr<const GrammarVersion> v = entry.second.lock()) parsers.insert(v->parser.get());
+    }
+    return parsers.size();
+}
+
+GrammarRegistry::SharingStats GrammarRegistry::sharing() const
+{
+    SharingStats stats;
+    {
+        lock_guard<mutex> lock(writing);
+        set<const CompiledParser*> parsers;
+        for (const auto& entry : byText) {
+            shared_ptr<const GrammarVersion> v = entry.second.lock();
+            if (v && parsers.insert(v->parser.get()).second) stats.referencedBytes += v->parser->pooledBytes();
+        }
+    }
+    stats.pooledBytes = pool->bytes();
+    return stats;
+}
+
+/* ——— Hot reload ——— */
+
+bool GrammarRegistry::watch(const string& name, const string& path, string* error)
+{
+    Watched w;
+    w.name = name;
+    w.path = path;
+    string text;
+    if (!fileStamp(path, w.mtime, w.size)) {
+        if (error) *error = "Error opening file: " + path;
+        return false;
+    }
+    if (!readFile(path, text, error) || !publish(name, text, error)) return false;
+
+    lock_guard<mutex> lock(watching);
+    auto same = [&](const Watched& other) { return other.name == name; };
+    watched.erase(remove_if(watched.begin(), watched.end(), same), watched.end());
+    watched.push_back(w);
+    if (!watcher.joinable()) watcher = thread(&GrammarRegistry::watchLoop, this);
+    return true;
+}
+
+void GrammarRegistry::unwatch(const string& name)
+{
+    lock_guard<mutex> lock(watching);
+    auto same = [&](const Watched& other) { return other.name == name; };
+    watched.erase(remove_if(watched.begin(), watched.end(), same), watched.end());
+}
+
+void GrammarRegistry::setPollInterval(chrono::milliseconds interval)
+{
+    lock_guard<mutex> lock(watching);
+    pollInterval = interval;
+}
+
+void GrammarRegistry::setReloadListener(ReloadListener l)
+{
+    lock_guard<mutex> lock(watching);
+    listener = move(l);
+}
+
+// Polls every watched file's stamp; a changed file is read and
+// republished with no lock held, so a slow compile delays only the watcher
+void GrammarRegistry::watchLoop()
+{
+    unique_lock<mutex> lock(watching);
+    while (!wake.wait_for(lock, pollInterval, [&] { return stopping; })) {
+        vector<Watched> files = watched;
+        ReloadListener notify = listener;
+        lock.unlock();
+
+        for (Watched& w : files) {
+            int64_t mtime, size;
+            // A file being replaced may be missing for a moment; try again next poll
+            if (!fileStamp(w.path, mtime, size) || (mtime == w.mtime && size == w.size)) continue;
+
+            string text, error;
+            shared_ptr<const GrammarVersion> before = find(w.name);
+            shared_ptr<const GrammarVersion> after;
+            if (readFile(w.path, text, &error)) after = publish(w.name, text, &error);
+
+            {
+                // Remember the stamp even if the compile failed, so a broken
+                // file is reported once rather than on every poll
+                lock_guard<mutex> relock(watching);
+                for (Watched& entry : watched) {
+                    if (entry.name == w.name && entry.path == w.path) {
+                        entry.mtime = mtime;
+                        entry.size = size;
+                    }
+                }
+            }
+            if (notify && after != before) notify(w.name, after.get(), error);
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "ll1.h"
+
+/* ——— Grammar registry ———
+   Compiled grammars by name, for programs that parse several dialects.
+   Each publish compiles outside any lock and then swaps in a new
+   immutable snapshot of the whole registry with one atomic shared_ptr
+   store; readers load that pointer and never wait for a compile.  A
+   GrammarVersion stays alive for as long as anyone holds it, so parses
+   already running on the old version finish on it.
+
+   Identical grammar text is compiled once: every name and version with
+   the same text shares one CompiledParser, and republishing a name's
+   current text is a no-op.  Grammars that differ are compiled into one
+   GrammarPool, so each symbol name and each right-hand side they have
+   in common is stored once; their tables are their own.  The pool only
+   grows, by what no earlier grammar had.  watch() republishes a file
+   whenever it changes, from a background thread; a reload that fails
+   to compile leaves the previous version in place.                     */
+
+struct GrammarVersion {
+    std::string name;
+    uint64_t version;                           // 1, 2, ... per name
+    std::string text;                           // the grammar it was compiled from
+    std::shared_ptr<const CompiledParser> parser;
+};
+
+class GrammarRegistry {
+public:
+    // Called from the watcher thread after each reload: the new version,
+    // or null and why the file didn't compile
+    typedef std::function<void(const std::string& name, const GrammarVersion* published,
+                               const std::string& error)> ReloadListener;
+
+    GrammarRegistry();
+    ~GrammarRegistry();                         // stops watching
+    GrammarRegistry(const GrammarRegistry&) = delete;
+    GrammarRegistry& operator=(const GrammarRegistry&) = delete;
+
+    // Make text name's current version; null (and the reason in error)
+    // if it doesn't compile, in which case the current version stays
+    std::shared_ptr<const GrammarVersion> publish(const std::string& name, std::string_view text,
+                                                  std::string* error = nullptr);
+    bool remove(const std::string& name);
+
+    // The current version, or null
+    std::shared_ptr<const GrammarVersion> find(const std::string& name) const;
+    // An older version too, as long as something still holds it
+    std::shared_ptr<const GrammarVersion> find(const std::string& name, uint64_t version) const;
+    std::vector<std::string> names() const;
+    size_t compiledCount() const;               // distinct CompiledParsers behind all versions
+    // Names and right-hand sides: the bytes the live parsers refer to,
+    // the bytes the pool holds for them, and the difference
+    struct SharingStats {
+        size_t referencedBytes = 0;
+        size_t pooledBytes = 0;
+        size_t savedBytes() const { return referencedBytes > pooledBytes ? referencedBytes - pooledBytes : 0; }
+    };
+    SharingStats sharing() const;
+
+    /* ——— Hot reload ——— */
+    // Publish path as name now, then again whenever it changes on disk
+    bool watch(const std::string& name, const std::string& path, std::string* error = nullptr);
+    void unwatch(const std::string& name);
+    void setPollInterval(std::chrono::milliseconds interval);   // default 500 ms
+    void setReloadListener(ReloadListener listener);
+
+private:
+    struct Entry {
+        std::shared_ptr<const GrammarVersion> current;
+        std::vector<std::weak_ptr<const GrammarVersion>> older;
+    };
+    typedef std::unordered_map<std::string, Entry> Snapshot;
+
+    struct Watched {
+        std::string name, path;
+        int64_t mtime = -1;                     // nanoseconds, -1 = never read
+        int64_t size = -1;
+    };
+
+    std::shared_ptr<const Snapshot> snapshot() const;
+    std::shared_ptr<const CompiledParser> compiled(std::string_view text, size_t hash, std::string* error);
+    void watchLoop();
+
+    std::shared_ptr<const Snapshot> entries;    // read with atomic_load, replaced with atomic_store
+    std::shared_ptr<GrammarPool> pool;          // every grammar's names and right-hand sides
+    mutable std::mutex writing;                 // serialises publishers; readers never take it
+    std::unordered_multimap<size_t, std::weak_ptr<const GrammarVersion>> byText;   // text hash -> versions
+    std::unordered_map<std::string, uint64_t> lastVersion;     // survives remove(), so ids aren't reused
+
+    std::mutex watching;
+    std::condition_variable wake;
+    std::vector<Watched> watched;
+    ReloadListener listener;
+    std::chrono::milliseconds pollInterval{500};
+    std::thread watcher;
+    bool stopping = false;
+};
+
+#endif   // REGISTRY_H
@@ -0,0 +1,250 @@
+#include "server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+
+namespace {
+
+constexpr size_t MAX_BATCH = 64;                 // requests a worker takes at once, at most
+constexpr auto FLUSH_AFTER = chrono::microseconds(50);   // replies older than this go out before the next parse
+constexpr size_t FLUSH_BEFORE = 1 << 10;          // requests this long are never parsed with replies pending
+constexpr uint32_t MAX_REQUEST = 64u << 20;      // larger frames drop the connection
+constexpr size_t READ_CHUNK = 64 << 10;
+
+struct Connection {
+    int in, out;
+    bool ownsFd;                    // sockets are closed with the last reference
+    mutex writing;                  // one reply batch at a time
+
+    Connection(int in, int out, bool ownsFd) : in(in), out(out), ownsFd(ownsFd) {}
+    ~Connection() { if (ownsFd) ::close(in); }
+};
+
+struct Request {
+    shared_ptr<Connection> conn;
+    uint32_t id;
+    string text;
+};
+
+/* Requests waiting for a worker.  push blocks while limit are waiting,
+   which stops the reader and, through the socket buffers, the client. */
+class RequestQueue {
+public:
+    explicit RequestQueue(size_t limit) : limit(max<size_t>(limit, 1)) {}
+
+    void push(vector<Request>& batch) {
+        unique_lock<mutex> lock(m);
+        for (Request& r : batch) {
+            notFull.wait(lock, [&] { return items.size() < limit || closed; });
+            if (closed) break;
+            items.push_back(move(r));
+            notEmpty.notify_one();
+        }
+        batch.clear();
+    }
+
+    // This worker's share of what is waiting: split evenly with the
+    // workers still idle, up to MAX_BATCH; false once closed and empty
+    bool pop(vector<Request>& batch) {
+        unique_lock<mutex> lock(m);
+        idle++;
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        idle--;
+        if (items.empty()) return false;
+        size_t n = min({items.size(), (items.size() + idle) / (idle + 1), MAX_BATCH});
+        for (size_t i = 0; i < n; i++) {
+            batch.push_back(move(items.front()));
+            items.pop_front();
+        }
+        if (!items.empty() && idle) notEmpty.notify_one();     // the rest is another worker's
+        notFull.notify_all();
+        return true;
+    }
+
+    void close() {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    mutex m;
+    condition_variable notEmpty, notFull;
+    deque<Request> items;
+    size_t limit;
+    size_t idle = 0;                // workers waiting in pop
+    bool closed = false;
+};
+
+void putU32(string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out += static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+uint32_t getU32(const char* p) {
+    const unsigned char* b = reinterpret_cast<const unsigned char*>(p);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+}
+
+void appendReply(string& out, uint32_t id, const ParseResult& result) {
+    string text = result.accepted ? "accept\n" : "reject\n";
+    for (const SyntaxError& e : result.errors) text += to_string(e.column) + " " + e.message + "\n";
+    putU32(out, static_cast<uint32_t>(text.size()));
+    putU32(out, id);
+    out += text;
+}
+
+// A peer that went away just loses its replies
+void writeAll(int fd, const string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        done += n;
+    }
+}
+
+// Replies are gathered per connection and written together.  They are
+// written before the next parse if that request is long or the oldest of
+// them is FLUSH_AFTER old, so a reply only ever waits on short parses
+void work(const GrammarRegistry& registry, const string& grammar, RequestQueue& queue) {
+    typedef chrono::steady_clock Clock;
+    vector<Request> batch;
+    vector<pair<Connection*, string>> replies;       // one buffer per connection with unwritten replies
+    Clock::time_point oldest;                        // when the first unwritten reply was ready
+    auto writeReplies = [&]() {
+        for (auto& reply : replies) {
+            lock_guard<mutex> lock(reply.first->writing);
+            writeAll(reply.first->out, reply.second);
+        }
+        replies.clear();
+    };
+    while (queue.pop(batch)) {
+        shared_ptr<const GrammarVersion> current = registry.find(grammar);
+        for (Request& r : batch) {
+            if (!replies.empty() && (r.text.size() >= FLUSH_BEFORE || Clock::now() - oldest >= FLUSH_AFTER))
+                writeReplies();
+            ParseResult result;
+            if (current) result = current->parser->parse(r.text);
+            else result.errors.push_back({1, 0, "Error: grammar " + grammar + " is not loaded"});
+            if (replies.empty()) oldest = Clock::now();
+            size_t i = 0;
+            while (i < replies.size() && replies[i].first != r.conn.get()) i++;
+            if (i == replies.size()) replies.push_back({r.conn.get(), string()});
+            appendReply(replies[i].second, r.id, result);
+        }
+        writeReplies();
+        batch.clear();                                // drops the connection references last
+    }
+}
+
+// Queue every frame on conn until EOF, an error, or an oversized frame.
+// All frames from one read go to the queue together.
+void readRequests(shared_ptr<Connection> conn, shared_ptr<RequestQueue> queue) {
+    vector<char> buffer(READ_CHUNK);
+    size_t have = 0;
+    vector<Request> batch;
+    while (true) {
+        if (have == buffer.size()) buffer.resize(buffer.size() * 2);
+        ssize_t n = ::read(conn->in, buffer.data() + have, buffer.size() - have);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        have += n;
+
+        size_t used = 0;
+        while (have - used >= 8) {
+            uint32_t length = getU32(&buffer[used]);
+            if (length > MAX_REQUEST) return;
+            if (have - used < 8 + size_t(length)) {
+                if (buffer.size() < 8 + size_t(length)) buffer.resize(8 + size_t(length));
+                break;
+            }
+            batch.push_back({conn, getU32(&buffer[used + 4]), string(&buffer[used + 8], length)});
+            used += 8 + length;
+        }
+        if (used) {
+            memmove(buffer.data(), buffer.data() + used, have - used);
+            have -= used;
+        }
+        if (!batch.empty()) queue->push(batch);
+    }
+}
+
+int listenOn(const string& path) {
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cerr << "Socket path too long: " << path << '\n';
+        return -1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        cerr << "Couldn't create a socket: " << strerror(errno) << '\n';
+        return -1;
+    }
+    unlink(path.c_str());                             // a stale socket from an earlier run
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        cerr << "Couldn't listen on " << path << ": " << strerror(errno) << '\n';
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}
+
+int runServer(const GrammarRegistry& registry, const string& grammar, const ServerOptions& options)
+{
+    signal(SIGPIPE, SIG_IGN);                         // a vanished client is a failed write, not a kill
+
+    int listener = -1;
+    if (options.endpoint != "-") {
+        listener = listenOn(options.endpoint);
+        if (listener < 0) return 1;
+    }
+
+    // Shared with the socket readers, which may outlive this call
+    auto queue = make_shared<RequestQueue>(options.queueLimit);
+    unsigned workers = options.workers > 0 ? options.workers : max(1u, thread::hardware_concurrency());
+    vector<thread> pool;
+    for (unsigned i = 0; i < workers; i++) pool.emplace_back(work, cref(registry), cref(grammar), ref(*queue));
+
+    if (listener < 0) {
+        readRequests(make_shared<Connection>(STDIN_FILENO, STDOUT_FILENO, false), queue);
+    } else {
+        // Readers end with their connection and aren't joined
+        while (true) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0 && errno == EINTR) continue;
+            if (fd < 0) {
+                cerr << "accept failed: " << strerror(errno) << '\n';
+                break;
+            }
+            thread(readRequests, make_shared<Connection>(fd, fd, true), queue).detach();
+        }
+        ::close(listener);
+    }
+
+    queue->close();
+    for (auto& t : pool) t.join();
+    return listener < 0 ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "registry.h"
+
+/* ——— Parse server (--serve) ———
+   Compiles the grammar once, then answers parse requests until its input
+   ends (stdin) or forever (a Unix domain socket, any number of clients).
+   Both speak the same framing; integers are 32-bit little-endian:
+
+     request   length, id, then length bytes of input (one sentence)
+     reply     length, id, then length bytes of text:
+                 "accept\n"
+               or "reject\n" and one "COLUMN MESSAGE\n" per syntax error
+
+   Replies carry the request's id and may come back out of order, so a
+   slow request never holds up the ones behind it.  A reader per
+   connection queues requests; when queueLimit of them are waiting, it
+   stops reading and the client's writes block (backpressure).  A worker
+   takes its share of what is queued (split with the idle workers, up to
+   a batch) and writes each connection's replies together.  Pending
+   replies are written before parsing a request of 1 KB or more, or once
+   the oldest has waited 50 us, so a reply is held back only by short
+   parses, never by a long one.
+
+   The parser comes from a GrammarRegistry, looked up once per batch, so
+   a grammar republished while serving (--watch) is picked up by the
+   next batch while the batches already running finish on the old one. */
+struct ServerOptions {
+    std::string endpoint;           // "-" = stdin/stdout, otherwise a socket path
+    int workers = 0;                // 0 = one per hardware thread
+    size_t queueLimit = 1024;       // requests read but not yet picked up
+};
+
+// Returns only when stdin ends, or on a setup error (printed on cerr)
+int runServer(const GrammarRegistry& registry, const std::string& grammar, const ServerOptions& options);
+
+#endif   // SERVER_H
@@ -2,644 +2,1120 @@
 using namespace std;
 
 
-// Opens input and output files and reads the grammar
-CFGProcessor::CFGProcessor(const string& filename, const string& outputFilename) {
-    outputFile.open(outputFilename);
-    if (!outputFile.is_open()) {
-        cerr << "Couldn't open the output file: " << outputFilename << endl;
-        exit(1);
+const string* GrammarPool::name(string_view text) {
+    lock_guard<mutex> hold(lock);
+    auto it = names.find(text);
+    if (it != names.end()) return it->second;
+    nameStore.emplace_back(text);
+    const string* interned = &nameStore.back();
+    names.emplace(string_view(*interned), interned);
+    stored += text.size();
+    return interned;
+}
+
+const Symbol* GrammarPool::sequence(const Symbol* symbols, size_t count) {
+    static const Symbol none[1] = {NO_SYMBOL};
+    if (count == 0) return none;
+    lock_guard<mutex> hold(lock);
+    auto it = sequences.find(string_view(reinterpret_cast<const char*>(symbols), count * sizeof(Symbol)));
+    if (it != sequences.end()) return it->second;
+    if (left < count) {
+        left = max(count, BLOCK);
+        blocks.emplace_back(new Symbol[left]);
+        next = blocks.back().get();
     }
+    Symbol* copy = next;
+    copy_n(symbols, count, copy);
+    next += count;
+    left -= count;
+    sequences.emplace(string_view(reinterpret_cast<const char*>(copy), count * sizeof(Symbol)), copy);
+    stored += count * sizeof(Symbol);
+    return copy;
+}
+
+size_t GrammarPool::bytes() const {
+    lock_guard<mutex> hold(lock);
+    return stored;
+}
+
+Symbol SymbolTable::find(const string& name) const {
+    auto it = ids.find(name);
+    return it == ids.end() ? NO_SYMBOL : it->second;
+}
+
+Symbol SymbolTable::add(const string& name) {
+    if (!pool) pool = make_shared<GrammarPool>();
+    Symbol id = size();
+    names.push_back(pool->name(name));
+    ids[*names.back()] = id;
+    return id;
+}
 
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Error opening file: " << filename << endl;
-        outputFile.close();
-        exit(1);
+Symbol SymbolTable::addTerminal(const string& name) {
+    Symbol id = find(name);
+    if (id != NO_SYMBOL) return id;
+    numTerminals++;
+    return add(name);
+}
+
+Symbol SymbolTable::addNonTerminal(const string& name) {
+    Symbol id = find(name);
+    if (isNonTerminal(id)) return id;
+
+    // Never shadow a terminal: keep priming the name until it's free
+    string fresh = name;
+    while (find(fresh) != NO_SYMBOL) fresh += "'";
+    return add(fresh);
+}
+
+Symbol Grammar::addNonTerminal(const string& name) {
+    Symbol id = symbols.addNonTerminal(name);
+    if (symbols.numNonTerminals() > static_cast<int>(productions.size())) {
+        productions.resize(symbols.numNonTerminals());
     }
+    return id;
+}
 
-    // Read the grammar line by line
-    string line;
-    while (getline(file, line)) {
+Symbol Grammar::addFreshNonTerminal(const string& base) {
+    string fresh = base + "'";
+    while (symbols.find(fresh) != NO_SYMBOL) fresh += "'";
+    return addNonTerminal(fresh);
+}
+
+// Non-terminals sorted by name, the order every report (and the
+// substitution order of eliminateLeftRecursion) has always used
+vector<Symbol> Grammar::nonTerminalsByName() const {
+    vector<Symbol> order;
+    for (Symbol s = symbols.numTerminals; s < symbols.size(); s++) {
+        order.push_back(s);
+    }
+    sort(order.begin(), order.end(), [&](Symbol a, Symbol b) {
+        return symbols.name(a) < symbols.name(b);
+    });
+    return order;
+}
+
+// Strip spaces and tabs from both ends
+static string_view trimBlanks(string_view s) {
+    size_t first = s.find_first_not_of(" \t");
+    if (first == string_view::npos) return string_view();
+    return s.substr(first, s.find_last_not_of(" \t") - first + 1);
+}
+
+// Opens the output file and reads the grammar file.  If either fails,
+// error() says which and the processor must not be used.
+CFGProcessor::CFGProcessor(const string& filename, const string& outputFilename)
+    : grammarFile(filename), trace(&output) {
+    PhaseTimer timer(metrics, "readGrammar");
+    consoleSink = output.addStream(stdout);
+    fileSink = output.addFile(outputFilename);
+    if (!fileSink) {
+        errorText = "Couldn't open the output file: " + outputFilename;
+        return;
+    }
+
+    LineReader file;
+    if (!file.open(filename)) {
+        errorText = "Error opening file: " + filename;
+        output.close();
+        return;
+    }
+    readGrammar(file);
+}
+
+// No files at all: the grammar comes from loadGrammar, the pipeline
+// stages report nothing and parse traces go nowhere
+CFGProcessor::CFGProcessor()
+    : output(TRACE_NONE), trace(&output) {
+    reports = false;
+}
+
+bool CFGProcessor::loadGrammar(string_view text) {
+    PhaseTimer timer(metrics, "readGrammar");
+    LineReader lines;
+    lines.openText(text);
+    return readGrammar(lines);
+}
+
+// Read the grammar line by line.  Symbols stay as text until every
+// terminal is known, because terminals get the low ids.
+bool CFGProcessor::readGrammar(LineReader& file) {
+    set<string> nonTerminalNames;
+    vector<string> lhsOrder;
+    map<string, vector<vector<string>>> rawProductions;
+    string startName;
+
+    string_view line;
+    while (file.nextLine(line)) {
         if (line.empty() || line[0] == '#') continue;
 
         // Find the arrow that separates LHS from RHS
-        int arrowPos = line.find("->");
-        if (arrowPos == string::npos) continue;
-
-        string lhs = line.substr(0, arrowPos);
-        string rhs = line.substr(arrowPos + 2);
+        size_t arrowPos = line.find("->");
+        if (arrowPos == string_view::npos) continue;
 
         // Clean up extra spaces
-        lhs.erase(0, lhs.find_first_not_of(" \t"));
-        lhs.erase(lhs.find_last_not_of(" \t") + 1);
-        rhs.erase(0, rhs.find_first_not_of(" \t"));
-        rhs.erase(rhs.find_last_not_of(" \t") + 1);
+        string lhs(trimBlanks(line.substr(0, arrowPos)));
+        string_view rhs = trimBlanks(line.substr(arrowPos + 2));
 
-        grammar.nonTerminals.insert(lhs);
+        if (nonTerminalNames.insert(lhs).second) {
+            lhsOrder.push_back(lhs);
+        }
 
-        if (grammar.startSymbol.empty()) {
-            grammar.startSymbol = lhs;
+        if (startName.empty()) {
+            startName = lhs;
         }
 
-        // Parse the alternatives (separated by '|')
-        istringstream rhsStream(rhs);
-        string alternative;
-        while (getline(rhsStream, alternative, '|')) {
-            alternative.erase(0, alternative.find_first_not_of(" \t"));
-            alternative.erase(alternative.find_last_not_of(" \t") + 1);
+        // Parse the alternatives (separated by '|'); like getline, an
+        // empty piece after a trailing '|' doesn't count
+        size_t altStart = 0;
+        while (altStart < rhs.size()) {
+            size_t bar = rhs.find('|', altStart);
+            if (bar == string_view::npos) bar = rhs.size();
+            string_view alternative = rhs.substr(altStart, bar - altStart);
+            altStart = bar + 1;
 
             // Break the right side into individual symbols
             vector<string> symbols;
-            istringstream symbolStream(alternative);
-            string symbol;
-            while (symbolStream >> symbol) {
-                symbols.push_back(symbol);
+            size_t i = 0;
+            while (i < alternative.size()) {
+                while (i < alternative.size() && isspace(static_cast<unsigned char>(alternative[i]))) i++;
+                size_t start = i;
+                while (i < alternative.size() && !isspace(static_cast<unsigned char>(alternative[i]))) i++;
+                if (i > start) symbols.push_back(string(alternative.substr(start, i - start)));
             }
             
             if (symbols.empty()) {
                 symbols.push_back("epsilon");
             }
             
-            grammar.productions[lhs].push_back(symbols);
+            rawProductions[lhs].push_back(symbols);
         }
     }
     file.close();
-    
-    grammar.terminals.insert("epsilon");
+    if (startName.empty()) {
+        errorText = "The grammar has no productions";
+        if (!grammarFile.empty()) errorText += ": " + grammarFile;
+        return false;
+    }
     
     // Any symbol that's not a non-terminal must be a terminal
-    for (const auto& entry : grammar.productions) {
+    set<string> terminalNames = {"epsilon", "$"};
+    for (const auto& entry : rawProductions) {
         for (int i = 0; i < entry.second.size(); i++) {
             const vector<string>& prod = entry.second[i];
             for (int j = 0; j < prod.size(); j++) {
                 const string& symbol = prod[j];
-                if (symbol != "epsilon" && grammar.nonTerminals.find(symbol) == grammar.nonTerminals.end()) {
-                    grammar.terminals.insert(symbol);
+                if (symbol != "epsilon" && nonTerminalNames.find(symbol) == nonTerminalNames.end()) {
+                    terminalNames.insert(symbol);
                 }
             }
         }
     }
-}
 
-CFGProcessor::~CFGProcessor() {
-    if (outputFile.is_open()) {
-        outputFile.close();
+    // Intern terminals first (in name order), then the non-terminals
+    for (const auto& t : terminalNames) {
+        grammar.symbols.addTerminal(t);
     }
-}
+    for (int i = 0; i < lhsOrder.size(); i++) {
+        grammar.addNonTerminal(lhsOrder[i]);
+    }
+    grammar.epsilon = grammar.symbols.find("epsilon");
+    grammar.endMarker = grammar.symbols.find("$");
+    grammar.startSymbol = grammar.symbols.find(startName);
 
-bool CFGProcessor::isTerminal(const string& symbol) {
-    return grammar.terminals.find(symbol) != grammar.terminals.end();
+    for (int i = 0; i < lhsOrder.size(); i++) {
+        const vector<vector<string>>& alternatives = rawProductions[lhsOrder[i]];
+        vector<vector<Symbol>>& rules = grammar.rules(grammar.symbols.find(lhsOrder[i]));
+        for (int j = 0; j < alternatives.size(); j++) {
+            vector<Symbol> prod;
+            for (int k = 0; k < alternatives[j].size(); k++) {
+                prod.push_back(grammar.symbols.find(alternatives[j][k]));
+            }
+            rules.push_back(prod);
+        }
+    }
+
+    // Terminals never change after this point, so the lexer can index them now
+    lexer = Lexer(grammar);
+    return true;
 }
 
-bool CFGProcessor::isNonTerminal(const string& symbol) {
-    return grammar.nonTerminals.find(symbol) != grammar.nonTerminals.end();
+CFGProcessor::~CFGProcessor() {
+    output.close();
 }
 
 // Show the grammar 
 void CFGProcessor::displayGrammar(const Grammar& g) {
-    cout << "Grammar:" << endl;
-    outputFile << "Grammar:" << endl;
+    output.write("Grammar:\n");
     
-    for (const auto& entry : g.productions) {
-        cout << entry.first << " -> ";
-        outputFile << entry.first << " -> ";
+    vector<Symbol> order = g.nonTerminalsByName();
+    string line;
+    for (int n = 0; n < order.size(); n++) {
+        const vector<vector<Symbol>>& rules = g.rules(order[n]);
+        line = g.symbols.name(order[n]) + " -> ";
         
-        for (int i = 0; i < entry.second.size(); i++) {
-            if (i > 0) {
-                cout << " | ";
-                outputFile << " | ";
-            }
+        for (int i = 0; i < rules.size(); i++) {
+            if (i > 0) line += " | ";
             
-            for (int j = 0; j < entry.second[i].size(); j++) {
-                cout << entry.second[i][j] << " ";
-                outputFile << entry.second[i][j] << " ";
+            for (int j = 0; j < rules[i].size(); j++) {
+                line += g.symbols.name(rules[i][j]);
+                line += ' ';
             }
         }
-        cout << endl;
-        outputFile << endl;
+        line += '\n';
+        output.write(line);
     }
-    cout << endl;
-    outputFile << endl;
+    output.write("\n");
 }
 
-// Apply left factoring to eliminate common prefixes
-void CFGProcessor::performLeftFactoring() {
-    Grammar newGrammar = grammar;
-    bool factored = false;
-    
-    do {
-        factored = false;
-        Grammar tempGrammar = newGrammar;
-        newGrammar.productions.clear();
-        
-        // Check each non-terminal for common prefixes
-        for (const auto& entry : tempGrammar.productions) {
-            string nonTerminal = entry.first;
-            vector<vector<string>> productions = entry.second;
-            
-            // Group productions by their first symbol
-            map<string, vector<vector<string>>> prefixMap;
-            for (int i = 0; i < productions.size(); i++) {
-                const vector<string>& prod = productions[i];
-                if (prod.empty()) continue;
-                string prefix = prod[0];
-                prefixMap[prefix].push_back(prod);
-            }
-            
-            // Look for common prefixes to factor out
-            bool localFactored = false;
-            for (const auto& prefixEntry : prefixMap) {
-                // If multiple productions start with the same symbol
-                if (prefixEntry.second.size() > 1) {
-                    localFactored = true;
-                    factored = true;
-                    
-                    // Make a new non-terminal with a prime (') suffix
-                    string newNonTerminal = nonTerminal + "'";
-                    newGrammar.nonTerminals.insert(newNonTerminal);
-                    
-                    // Add a production with the common prefix followed by the new non-terminal
-                    vector<string> prefixProd = {prefixEntry.first, newNonTerminal};
-                    newGrammar.productions[nonTerminal].push_back(prefixProd);
-                    
-                    // Add new productions for the new non-terminal
-                    for (int i = 0; i < prefixEntry.second.size(); i++) {
-                        const vector<string>& prod = prefixEntry.second[i];
-                        vector<string> newProd;
-                        
-                        // Skip the common prefix (first symbol)
-                        for (int j = 1; j < prod.size(); j++) {
-                            newProd.push_back(prod[j]);
-                        }
-                        
-                        // If nothing's left, add epsilon
-                        if (newProd.empty()) {
-                            newProd.push_back("epsilon");
-                        }
-                        
-                        newGrammar.productions[newNonTerminal].push_back(newProd);
-                    }
-                } else {
-                    // Keep productions without common prefixes
-                    for (int i = 0; i < prefixEntry.second.size(); i++) {
-                        newGrammar.productions[nonTerminal].push_back(prefixEntry.second[i]);
-                    }
-                }
+// Alternatives of one non-terminal as a prefix trie.  A node's entries
+// keep first-occurrence order; END marks an alternative ending there.
+struct PrefixTrie {
+    static constexpr int END = -1;
+    struct Node {
+        Symbol symbol;
+        vector<int> entries;    // child node or END
+        bool ends = false;
+    };
+    vector<Node> nodes;
+    unordered_map<uint64_t, int> edges;    // (node, symbol) -> child
+
+    void reset() {
+        nodes.assign(1, Node{NO_SYMBOL, {}});
+        edges.clear();
+    }
+    void insert(const vector<Symbol>& alternative) {
+        int node = 0;
+        for (int i = 0; i < alternative.size(); i++) {
+            uint64_t key = (uint64_t(node) << 32) | uint32_t(alternative[i]);
+            auto it = edges.find(key);
+            if (it == edges.end()) {
+                int child = static_cast<int>(nodes.size());
+                nodes.push_back(Node{alternative[i], {}});
+                nodes[node].entries.push_back(child);
+                it = edges.emplace(key, child).first;
             }
-            
-            // If we didn't factor anything, keep the original productions
-            if (!localFactored) {
-                newGrammar.productions[nonTerminal] = productions;
+            node = it->second;
+        }
+        if (!nodes[node].ends) {            // a duplicate alternative adds nothing
+            nodes[node].ends = true;
+            nodes[node].entries.push_back(END);
+        }
+    }
+};
+
+// Rules for the suffixes below node: a branch-free path is one
+// alternative, and wherever paths split after a shared prefix the split
+// goes into a fresh non-terminal (lhs' , lhs'' ...).  Alternatives are
+// inserted without epsilons, so an empty suffix is only ever END.
+static void emitFactored(const PrefixTrie& trie, int node, const string& lhs, Grammar& g,
+                         vector<vector<Symbol>>& out) {
+    const vector<int>& entries = trie.nodes[node].entries;
+    for (int e = 0; e < entries.size(); e++) {
+        if (entries[e] == PrefixTrie::END) {
+            out.push_back({g.epsilon});                    // only below the root
+            continue;
+        }
+        vector<Symbol> alternative;
+        int n = entries[e];
+        alternative.push_back(trie.nodes[n].symbol);
+        while (trie.nodes[n].entries.size() == 1 && !trie.nodes[n].ends) {
+            n = trie.nodes[n].entries[0];
+            alternative.push_back(trie.nodes[n].symbol);
+        }
+        if (trie.nodes[n].entries.size() > 1) {
+            Symbol tail = g.addFreshNonTerminal(lhs);
+            alternative.push_back(tail);
+            vector<vector<Symbol>> tailRules;
+            emitFactored(trie, n, lhs, g, tailRules);
+            g.rules(tail) = move(tailRules);
+        }
+        out.push_back(alternative);
+    }
+}
+
+// Apply left factoring: factor out the longest common prefix of every
+// group of alternatives in a single pass over each non-terminal's trie,
+// so the work is linear in the size of the grammar.  Epsilons are dropped
+// from alternatives first, so "X" and "X epsilon" are one alternative.
+void CFGProcessor::performLeftFactoring() {
+    PhaseTimer timer(metrics, "performLeftFactoring");
+    vector<Symbol> order = grammar.nonTerminalsByName();
+    PrefixTrie trie;
+    vector<Symbol> alternative;
+    for (int n = 0; n < order.size(); n++) {
+        Symbol nonTerminal = order[n];
+        const vector<vector<Symbol>>& productions = grammar.rules(nonTerminal);
+        trie.reset();
+        for (int i = 0; i < productions.size(); i++) {
+            if (productions[i].empty()) continue;
+            alternative.clear();
+            for (Symbol s : productions[i]) {
+                if (s != grammar.epsilon) alternative.push_back(s);
             }
+            if (alternative.empty()) alternative.push_back(grammar.epsilon);
+            trie.insert(alternative);
         }
-    } while (factored);
+        if (trie.nodes.size() == 1) continue;
+
+        vector<vector<Symbol>> factored;
+        emitFactored(trie, 0, grammar.symbols.name(nonTerminal), grammar, factored);
+        grammar.rules(nonTerminal) = move(factored);
+    }
     
-    grammar = newGrammar;
-    cout << "Grammar after Left Factoring:" << endl;
-    outputFile << "Grammar after Left Factoring:" << endl;
+    if (!reports) return;
+    output.write("Grammar after Left Factoring:\n");
     displayGrammar(grammar);
 }
 
-// Eliminate left recursion (both direct and indirect)
-void CFGProcessor::eliminateLeftRecursion() {
-    vector<string> origNonTerminals;
-    for (const auto& entry : grammar.productions) {
-        origNonTerminals.push_back(entry.first);
+// Left-recursion substitution can multiply the grammar's size; past this
+// many symbols (about 64 MB of right-hand sides) it is reported instead
+static const long long MAX_GRAMMAR_SYMBOLS = 1LL << 24;
+
+// Rules as ropes: a rule is a run of spans over one shared symbol
+// arena, so substituting Aj's rules into "Aj gamma" appends a few span
+// records pointing at the existing symbols instead of copying them.
+struct RuleArena {
+    struct Span { int start; int length; };
+    struct Rope { int first; int count; int length; };   // spans [first, first + count), length symbols
+
+    vector<Symbol> symbols;
+    vector<Span> spans;
+
+    Rope add(const vector<Symbol>& rule) {
+        Rope r{static_cast<int>(spans.size()), 0, static_cast<int>(rule.size())};
+        if (!rule.empty()) {
+            spans.push_back({static_cast<int>(symbols.size()), r.length});
+            symbols.insert(symbols.end(), rule.begin(), rule.end());
+            r.count = 1;
+        }
+        return r;
     }
-    
-    map<string, vector<vector<string>>> newProds = grammar.productions;
-    
-    for (int i = 0; i < origNonTerminals.size(); i++) {
-        string Ai = origNonTerminals[i];
-        
-        // First, eliminate indirect left recursion
-        for (int j = 0; j < i; j++) {
-            string Aj = origNonTerminals[j];
-            vector<vector<string>> updated;
-            
-            // Check each production of Ai
-            for (int k = 0; k < newProds[Ai].size(); k++) {
-                const vector<string>& production = newProds[Ai][k];
-                
-                // If it starts with Aj, substitute Aj's productions
-                if (!production.empty() && production[0] == Aj) {
-                    // Get the rest of the production after Aj
-                    vector<string> gamma(production.begin() + 1, production.end());
-                    
-                    // For each production of Aj, create a new production for Ai
-                    for (int m = 0; m < newProds[Aj].size(); m++) {
-                        const vector<string>& delta = newProds[Aj][m];
-                        vector<string> newProduction;
-                        
-                        // Add Aj's production first
-                        for (int n = 0; n < delta.size(); n++) {
-                            newProduction.push_back(delta[n]);
-                        }
-                        
-                        // Then add the rest of the original production
-                        for (int n = 0; n < gamma.size(); n++) {
-                            newProduction.push_back(gamma[n]);
-                        }
-                        
-                        updated.push_back(newProduction);
-                    }
-                } else {
-                    // Keep productions that don't start with Aj
-                    updated.push_back(production);
-                }
-            }
-            newProds[Ai] = updated;
+    Symbol lead(const Rope& r) const {
+        return r.count ? symbols[spans[r.first].start] : NO_SYMBOL;
+    }
+    // a followed by b, minus the first `skip` symbols of a
+    Rope join(const Rope& a, const Rope& b, int skip = 0) {
+        Rope r{static_cast<int>(spans.size()), 0, a.length + b.length - skip};
+        for (int i = 0; i < a.count; i++) {
+            Span span = spans[a.first + i];
+            if (i == 0 && skip) span = {span.start + skip, span.length - skip};
+            if (span.length) spans.push_back(span);
         }
-        
-        // Eliminate direct left recursion
-        vector<vector<string>> alpha; 
-        vector<vector<string>> beta;  
-        
-        for (int j = 0; j < newProds[Ai].size(); j++) {
-            const vector<string>& production = newProds[Ai][j];
-            
-            if (!production.empty() && production[0] == Ai) {
-                // Remove the leading Ai and save this as an alpha production
-                vector<string> alphaPart(production.begin() + 1, production.end());
-                alpha.push_back(alphaPart);
-            } else {
-                beta.push_back(production);
-            }
+        for (int i = 0; i < b.count; i++) spans.push_back(spans[b.first + i]);
+        r.count = static_cast<int>(spans.size()) - r.first;
+        return r;
+    }
+    void materialize(const Rope& r, vector<Symbol>& out) const {
+        out.clear();
+        out.reserve(r.length);
+        for (int i = 0; i < r.count; i++) {
+            const Span& span = spans[r.first + i];
+            out.insert(out.end(), symbols.begin() + span.start, symbols.begin() + span.start + span.length);
         }
-        
-        // If we found left recursion, eliminate it
-        if (!alpha.empty()) {
-            string candidate = Ai + "'";
-            if (grammar.nonTerminals.find(candidate) != grammar.nonTerminals.end()) {
-                candidate = Ai + "''";
+    }
+};
+
+// Eliminate left recursion (both direct and indirect)
+bool CFGProcessor::eliminateLeftRecursion() {
+    PhaseTimer timer(metrics, "eliminateLeftRecursion");
+    typedef RuleArena::Rope Rope;
+    vector<Symbol> origNonTerminals = grammar.nonTerminalsByName();
+    const int base = grammar.symbols.numTerminals;
+
+    RuleArena arena;
+    vector<vector<Rope>> rules(grammar.productions.size());
+    long long total = 0;
+    for (int n = 0; n < grammar.productions.size(); n++) {
+        for (int k = 0; k < grammar.productions[n].size(); k++) {
+            rules[n].push_back(arena.add(grammar.productions[n][k]));
+            total += grammar.productions[n][k].size();
+        }
+    }
+    const Rope epsilonRule = arena.add({grammar.epsilon});
+
+    // Position in the substitution order; fresh non-terminals never get substituted
+    vector<int> rank(grammar.productions.size(), INT_MAX);
+    for (int i = 0; i < origNonTerminals.size(); i++) rank[origNonTerminals[i] - base] = i;
+
+    vector<Rope> pending, expanded, alpha, beta;
+    for (int i = 0; i < origNonTerminals.size(); i++) {
+        Symbol Ai = origNonTerminals[i];
+
+        // Indirect recursion: a rule "Aj gamma" with Aj earlier in the order
+        // becomes Aj's (already transformed) rules followed by gamma, in place,
+        // until its leading symbol is not an earlier non-terminal
+        expanded.clear();
+        pending.assign(rules[Ai - base].rbegin(), rules[Ai - base].rend());
+        while (!pending.empty()) {
+            Rope rule = pending.back();
+            pending.pop_back();
+            Symbol Aj = arena.lead(rule);
+            if (!isNonTerminal(Aj) || rank[Aj - base] >= i) {
+                expanded.push_back(rule);
+                continue;
             }
-            string newNonTerminal = (Ai == "T") ? "T''" : candidate;
-            grammar.nonTerminals.insert(newNonTerminal);
-            
-            // For each beta production, append the new non-terminal
-            vector<vector<string>> newBeta;
-            for (int j = 0; j < beta.size(); j++) {
-                vector<string> prod = beta[j];
-                prod.push_back(newNonTerminal);
-                newBeta.push_back(prod);
+            const vector<Rope>& deltas = rules[Aj - base];
+            const Rope gamma = arena.join(rule, Rope{0, 0, 0}, 1);
+            total -= rule.length;
+            for (int m = static_cast<int>(deltas.size()) - 1; m >= 0; m--) {
+                pending.push_back(arena.join(deltas[m], gamma));
+                total += pending.back().length;
             }
-            newProds[Ai] = newBeta;
-            
-            // For each alpha production, create a new production for the new non-terminal
-            vector<vector<string>> newAlpha;
-            for (int j = 0; j < alpha.size(); j++) {
-                vector<string> prod = alpha[j];
-                prod.push_back(newNonTerminal);
-                newAlpha.push_back(prod);
+            if (total > MAX_GRAMMAR_SYMBOLS) {
+                errorText = "Left recursion elimination: substituting " + grammar.symbols.name(Aj) +
+                            " into " + grammar.symbols.name(Ai) + " grows the grammar past " +
+                            to_string(MAX_GRAMMAR_SYMBOLS) + " symbols";
+                return false;
             }
-            
-            // Also add the option to derive epsilon
-            newAlpha.push_back(vector<string>{"epsilon"});
-            newProds[newNonTerminal] = newAlpha;
         }
+
+        // Direct recursion: Ai -> Ai alpha | beta  becomes
+        // Ai -> beta Ai'  and  Ai' -> alpha Ai' | epsilon
+        alpha.clear();
+        beta.clear();
+        for (int k = 0; k < expanded.size(); k++) {
+            if (arena.lead(expanded[k]) == Ai) alpha.push_back(expanded[k]);
+            else beta.push_back(expanded[k]);
+        }
+        if (alpha.empty()) {
+            rules[Ai - base] = expanded;
+            continue;
+        }
+
+        Symbol newNonTerminal = grammar.addFreshNonTerminal(grammar.symbols.name(Ai));
+        rules.resize(grammar.productions.size());
+        rank.resize(grammar.productions.size(), INT_MAX);
+        const Rope tail = arena.add({newNonTerminal});
+
+        vector<Rope>& aiRules = rules[Ai - base];
+        aiRules.clear();
+        for (int k = 0; k < beta.size(); k++) aiRules.push_back(arena.join(beta[k], tail));
+
+        vector<Rope>& tailRules = rules[newNonTerminal - base];
+        for (int k = 0; k < alpha.size(); k++) tailRules.push_back(arena.join(alpha[k], tail, 1));
+        tailRules.push_back(epsilonRule);
+        total += beta.size() + 1;        // beta rules gain Ai', alpha rules trade Ai for it, plus epsilon
     }
+
+    for (int n = 0; n < rules.size(); n++) {
+        grammar.productions[n].resize(rules[n].size());
+        for (int k = 0; k < rules[n].size(); k++) arena.materialize(rules[n][k], grammar.productions[n][k]);
+    }
+    if (!reports) return true;
     
-    grammar.productions = newProds;
-    
-    cout << "Grammar after Left Recursion Elimination:" << endl;
-    outputFile << "Grammar after Left Recursion Elimination:" << endl;
+    output.write("Grammar after Left Recursion Elimination:\n");
     displayGrammar(grammar);
+    return true;
 }
 
-// Compute the FIRST set for a sequence of symbols
-set<string> CFGProcessor::computeFirstOfString(const vector<string>& symbols) {
-    set<string> firstSet;
+// Find the non-terminals that derive epsilon.  Each production counts the
+// symbols still blocking it; when a non-terminal turns nullable, only the
+// productions that mention it are revisited.
+// With a cone, only the non-terminals in it are recomputed; the rest keep
+// their current (known good) values and act as constants.
+void CFGProcessor::computeNullable(const vector<bool>* cone) {
+    const int base = grammar.symbols.numTerminals;
+    const int count = grammar.symbols.numNonTerminals();
+    auto inCone = [&](Symbol nt) { return !cone || (*cone)[nt - base]; };
+    if (!cone) nullable.assign(count, false);
+    for (int i = 0; cone && i < count; i++) {
+        if ((*cone)[i]) nullable[i] = false;
+    }
+    
+    vector<pair<Symbol, int>> blockers;          // (lhs, symbols not yet known nullable)
+    vector<vector<int>> mentionedIn(count);      // non-terminal -> productions using it
+    vector<Symbol> worklist;
     
-    // If there's nothing in the sequence, the FIRST set is just epsilon
-    if (symbols.empty()) {
-        firstSet.insert("epsilon");
-        return firstSet;
+    for (Symbol nt = base; nt < grammar.symbols.size(); nt++) {
+        if (!inCone(nt)) continue;
+        const vector<vector<Symbol>>& rules = grammar.rules(nt);
+        for (int i = 0; i < rules.size(); i++) {
+            int p = blockers.size();
+            int pending = 0;
+            for (int j = 0; j < rules[i].size(); j++) {
+                Symbol s = rules[i][j];
+                if (s == grammar.epsilon) continue;
+                if (isNonTerminal(s) && !inCone(s) && isNullable(s)) continue;
+                pending++;
+                if (isNonTerminal(s) && inCone(s)) mentionedIn[s - base].push_back(p);
+            }
+            blockers.push_back({nt, pending});
+            if (pending == 0 && !nullable[nt - base]) {
+                nullable[nt - base] = true;
+                worklist.push_back(nt);
+            }
+        }
     }
     
-    // Assume all symbols can derive epsilon until proven otherwise
-    bool allHaveEpsilon = true;
+    while (!worklist.empty()) {
+        Symbol nt = worklist.back();
+        worklist.pop_back();
+        const vector<int>& uses = mentionedIn[nt - base];
+        for (int i = 0; i < uses.size(); i++) {
+            pair<Symbol, int>& p = blockers[uses[i]];
+            if (--p.second == 0 && !nullable[p.first - base]) {
+                nullable[p.first - base] = true;
+                worklist.push_back(p.first);
+            }
+        }
+    }
+}
+
+// Compute the FIRST set for a sequence of symbols
+TerminalSet CFGProcessor::computeFirstOfString(const vector<Symbol>& symbols) {
+    TerminalSet firstSet(grammar.symbols.numTerminals);
     
     for (int i = 0; i < symbols.size(); i++) {
-        string currentSymbol = symbols[i];
+        Symbol currentSymbol = symbols[i];
         
-        if (currentSymbol == "epsilon") {
+        if (currentSymbol == grammar.epsilon) {
             continue;
         }
         
         // If it's a terminal, add it to FIRST and we're done
         if (isTerminal(currentSymbol)) {
             firstSet.insert(currentSymbol);
-            allHaveEpsilon = false;
-            break;
+            return firstSet;
         }
         
-        // If it's a non-terminal, add its FIRST set (except epsilon)
-        if (isNonTerminal(currentSymbol)) {
-            for (const auto& term : firstSets[currentSymbol]) {
-                if (term != "epsilon") {
-                    firstSet.insert(term);
+        // A non-terminal adds its FIRST set (except epsilon) and stops the
+        // scan unless it can vanish
+        firstSet.unionWith(firstOf(currentSymbol), grammar.epsilon);
+        if (!isNullable(currentSymbol)) {
+            return firstSet;
+        }
+    }
+    
+    // Every symbol can derive epsilon (or there were none)
+    firstSet.insert(grammar.epsilon);
+    return firstSet;
+}
+
+// Print FIRST or FOLLOW sets of every non-terminal, in name order
+void CFGProcessor::printSets(const string& label, const vector<TerminalSet>& sets) {
+    if (!reports) return;
+    output.write(label + " Sets:\n");
+    vector<Symbol> order = grammar.nonTerminalsByName();
+    string line;
+    for (int n = 0; n < order.size(); n++) {
+        line = label + "(" + grammar.symbols.name(order[n]) + ") = { ";
+        bool first = true;
+        sets[order[n] - grammar.symbols.numTerminals].forEach([&](Symbol symbol) {
+            if (!first) line += ", ";
+            line += grammar.symbols.name(symbol);
+            first = false;
+        });
+        line += " }\n";
+        output.write(line);
+    }
+    output.write("\n");
+}
+
+// Compute FIRST sets for all non-terminals in the grammar.
+// Each production contributes the terminals it can start with directly,
+// plus an edge B -> A for every non-terminal B that can lead A's
+// right-hand side; a worklist then pushes FIRST(B) along those edges
+// until nothing grows, so no production is re-scanned.
+void CFGProcessor::computeFirstSets() {
+    PhaseTimer timer(metrics, "computeFirstSets");
+    computeNullable();
+    propagateFirst(nullptr);
+    
+    // Show the FIRST sets
+    printSets("FIRST", firstSets);
+}
+
+// The FIRST fixed point behind computeFirstSets (nullable must be current).
+// With a cone, non-terminals outside it keep their sets and feed the cone
+// as constants.
+void CFGProcessor::propagateFirst(const vector<bool>* cone) {
+    const int base = grammar.symbols.numTerminals;
+    const int count = grammar.symbols.numNonTerminals();
+    auto inCone = [&](Symbol nt) { return !cone || (*cone)[nt - base]; };
+    if (!cone) firstSets.assign(count, TerminalSet(base));
+    vector<vector<Symbol>> feeds(count);         // B -> non-terminals whose FIRST includes FIRST(B)
+    
+    for (Symbol nonTerminal = base; nonTerminal < grammar.symbols.size(); nonTerminal++) {
+        if (!inCone(nonTerminal)) continue;
+        const vector<vector<Symbol>>& rules = grammar.rules(nonTerminal);
+        TerminalSet& first = firstOf(nonTerminal);
+        first.clear();
+        if (isNullable(nonTerminal)) {
+            first.insert(grammar.epsilon);
+        }
+        
+        for (int i = 0; i < rules.size(); i++) {
+            const vector<Symbol>& production = rules[i];
+            for (int j = 0; j < production.size(); j++) {
+                Symbol s = production[j];
+                if (s == grammar.epsilon) continue;
+                if (isTerminal(s)) {
+                    first.insert(s);
+                    break;
                 }
-            }
-            
-            // Check if epsilon is in this non-terminal's FIRST set
-            bool epsilonInFirst = firstSets[currentSymbol].find("epsilon") != firstSets[currentSymbol].end();
-            
-            // If epsilon isn't in the FIRST set, we're done
-            if (!epsilonInFirst) {
-                allHaveEpsilon = false;
-                break;
+                if (!inCone(s)) first.unionWith(firstOf(s), grammar.epsilon);
+                else if (s != nonTerminal) feeds[s - base].push_back(nonTerminal);
+                if (!isNullable(s)) break;
             }
         }
     }
     
-    // If all symbols can derive epsilon, add epsilon to the result
-    if (allHaveEpsilon) {
-        firstSet.insert("epsilon");
+    vector<Symbol> worklist;
+    vector<bool> queued(count, false);
+    for (Symbol nt = grammar.symbols.size() - 1; nt >= base; nt--) {
+        if (!inCone(nt)) continue;
+        queued[nt - base] = true;
+        worklist.push_back(nt);
+    }
+    while (!worklist.empty()) {
+        Symbol B = worklist.back();
+        worklist.pop_back();
+        queued[B - base] = false;
+        
+        const vector<Symbol>& targets = feeds[B - base];
+        for (int i = 0; i < targets.size(); i++) {
+            Symbol A = targets[i];
+            if (firstOf(A).unionWith(firstOf(B), grammar.epsilon) && !queued[A - base]) {
+                queued[A - base] = true;
+                worklist.push_back(A);
+            }
+        }
     }
+}
+
+// Compute FOLLOW sets for all non-terminals.
+// One right-to-left pass over each production gives FIRST of the suffix
+// after every non-terminal B (added to FOLLOW(B) directly) and whether
+// that suffix is nullable (then FOLLOW(A) flows into FOLLOW(B) and is
+// recorded as an edge).  The edges are then closed with a worklist.
+void CFGProcessor::computeFollowSets() {
+    PhaseTimer timer(metrics, "computeFollowSets");
+    propagateFollow(nullptr, nullptr);
     
-    return firstSet;
+    // Show the FOLLOW sets
+    printSets("FOLLOW", followSets);
 }
 
-// Compute FIRST sets for all symbols in the grammar
-void CFGProcessor::computeFirstSets() {
-    for (const auto& nt : grammar.nonTerminals) {
-        firstSets[nt] = set<string>();
+// The FOLLOW fixed point behind computeFollowSets.  With a cone, only its
+// members are recomputed, from the productions of the non-terminals in
+// scan (which must include every production mentioning a member).
+void CFGProcessor::propagateFollow(const vector<bool>* cone, const vector<Symbol>* scan) {
+    const int base = grammar.symbols.numTerminals;
+    const int count = grammar.symbols.numNonTerminals();
+    auto inCone = [&](Symbol nt) { return !cone || (*cone)[nt - base]; };
+    if (!cone) followSets.assign(count, TerminalSet(base));
+    for (int i = 0; cone && i < count; i++) {
+        if ((*cone)[i]) followSets[i].clear();
     }
+    vector<vector<Symbol>> feeds(count);         // A -> non-terminals whose FOLLOW includes FOLLOW(A)
+    
+    if (inCone(grammar.startSymbol)) followOf(grammar.startSymbol).insert(grammar.endMarker);
     
-    for (const auto& t : grammar.terminals) {
-        firstSets[t] = {t};
+    vector<Symbol> all;
+    if (!scan) {
+        for (Symbol nt = base; nt < grammar.symbols.size(); nt++) all.push_back(nt);
+        scan = &all;
     }
     
-    bool changed;
-    do {
-        changed = false;
+    TerminalSet trailer(base);
+    for (int n = 0; n < scan->size(); n++) {
+        Symbol nonTerminal = (*scan)[n];
+        const vector<vector<Symbol>>& rules = grammar.rules(nonTerminal);
         
-        for (const auto& entry : grammar.productions) {
-            string nonTerminal = entry.first;
+        for (int i = 0; i < rules.size(); i++) {
+            const vector<Symbol>& production = rules[i];
+            trailer.clear();
+            bool trailerNullable = true;
             
-            for (int i = 0; i < entry.second.size(); i++) {
-                const vector<string>& production = entry.second[i];
+            for (int j = static_cast<int>(production.size()) - 1; j >= 0; j--) {
+                Symbol X = production[j];
+                if (X == grammar.epsilon) continue;
                 
-                // Special case for epsilon productions
-                if (production.size() == 1 && production[0] == "epsilon") {
-                    if (firstSets[nonTerminal].find("epsilon") == firstSets[nonTerminal].end()) {
-                        firstSets[nonTerminal].insert("epsilon");
-                        changed = true;
-                    }
+                if (isTerminal(X)) {
+                    trailer.clear();
+                    trailer.insert(X);
+                    trailerNullable = false;
                     continue;
                 }
                 
-                // Remove any epsilon symbols from the production
-                vector<string> filteredProduction;
-                for (int j = 0; j < production.size(); j++) {
-                    if (production[j] != "epsilon") {
-                        filteredProduction.push_back(production[j]);
-                    }
-                }
-                
-                // If everything was epsilon, add epsilon to FIRST
-                if (filteredProduction.empty()) {
-                    if (firstSets[nonTerminal].find("epsilon") == firstSets[nonTerminal].end()) {
-                        firstSets[nonTerminal].insert("epsilon");
-                        changed = true;
+                // X is a non-terminal: FIRST(suffix) - {epsilon} goes into FOLLOW(X)
+                if (inCone(X)) {
+                    followOf(X).unionWith(trailer);
+                    if (trailerNullable && X != nonTerminal) {
+                        if (inCone(nonTerminal)) feeds[nonTerminal - base].push_back(X);
+                        else followOf(X).unionWith(followOf(nonTerminal));
                     }
-                    continue;
                 }
                 
-                // Compute FIRST of this production
-                set<string> productionFirst = computeFirstOfString(filteredProduction);
-                
-                // Check if adding these symbols changes the FIRST set
-                int beforeSize = firstSets[nonTerminal].size();
-                firstSets[nonTerminal].insert(productionFirst.begin(), productionFirst.end());
-                if (firstSets[nonTerminal].size() > beforeSize) {
-                    changed = true;
+                if (!isNullable(X)) {
+                    trailer.clear();
+                    trailerNullable = false;
                 }
+                trailer.unionWith(firstOf(X), grammar.epsilon);
             }
         }
-    } while (changed);
+    }
     
-    // Show the FIRST sets
-    cout << "FIRST Sets:" << endl;
-    outputFile << "FIRST Sets:" << endl;
-    for (const auto& entry : firstSets) {
-        if (isNonTerminal(entry.first)) {
-            cout << "FIRST(" << entry.first << ") = { ";
-            outputFile << "FIRST(" << entry.first << ") = { ";
-            bool first = true;
-            for (const auto& symbol : entry.second) {
-                if (!first) {
-                    cout << ", ";
-                    outputFile << ", ";
-                }
-                cout << symbol;
-                outputFile << symbol;
-                first = false;
+    vector<Symbol> worklist;
+    vector<bool> queued(count, false);
+    for (Symbol nt = grammar.symbols.size() - 1; nt >= base; nt--) {
+        if (!inCone(nt)) continue;
+        queued[nt - base] = true;
+        worklist.push_back(nt);
+    }
+    while (!worklist.empty()) {
+        Symbol A = worklist.back();
+        worklist.pop_back();
+        queued[A - base] = false;
+        
+        const vector<Symbol>& targets = feeds[A - base];
+        for (int i = 0; i < targets.size(); i++) {
+            Symbol B = targets[i];
+            if (followOf(B).unionWith(followOf(A)) && !queued[B - base]) {
+                queued[B - base] = true;
+                worklist.push_back(B);
             }
-            cout << " }" << endl;
-            outputFile << " }" << endl;
         }
     }
-    cout << endl;
-    outputFile << endl;
 }
 
-// Compute FOLLOW sets for all non-terminals
-void CFGProcessor::computeFollowSets() {
-    for (const auto& nt : grammar.nonTerminals) {
-        followSets[nt] = set<string>();
+// What the parse driver needs besides the table, derived from it.
+//
+// Panic-mode recovery skips input until the lookahead is in the sync set
+// of the non-terminal being expanded, then pops it.  The end marker is in
+// every set, so recovery always stops at the end of the input.  Between
+// two tokens, a chain of expansions visits each non-terminal at most once,
+// which bounds how far the stack can legally grow.
+//
+// Expanding production p pushes pushArena[pushStart[p], pushStart[p+1]):
+// its right-hand side reversed, with epsilon left out, so an epsilon
+// production pushes nothing and the driver never looks for it.  The
+// driver reaches the slice through pushFrom, which shareStorage can
+// point into a GrammarPool instead.
+void CFGProcessor::buildDriverTables() {
+    const int base = grammar.symbols.numTerminals;
+    const int count = grammar.symbols.numNonTerminals();
+
+    syncSets = followSets;
+    for (int i = 0; i < syncSets.size(); i++) syncSets[i].insert(grammar.endMarker);
+
+    stackActions.assign(grammar.symbols.size(), ACT_EXPAND);
+    fill(stackActions.begin(), stackActions.begin() + base, ACT_MATCH);
+    if (grammar.endMarker != NO_SYMBOL) stackActions[grammar.endMarker] = ACT_ACCEPT;
+
+    size_t longest = 0;
+    pushArena.clear();
+    pushStart.assign(1, 0);
+    vector<int> firstProduction(count + 1, productionArena.size());
+    for (int p = static_cast<int>(productionArena.size()) - 1; p >= 0; p--) {
+        firstProduction[productionArena[p].lhs - base] = p;
     }
-    
-    followSets[grammar.startSymbol].insert("$");
-    
-    bool changed;
-    do {
-        changed = false;
-        
-        // Check each production rule
-        for (const auto& entry : grammar.productions) {
-            string nonTerminal = entry.first;
-            
-            for (int i = 0; i < entry.second.size(); i++) {
-                const vector<string>& production = entry.second[i];
-                
-                for (int j = 0; j < production.size(); j++) {
-                    // We only care about non-terminals in the production
-                    if (!isNonTerminal(production[j])) continue;
-                    
-                    string B = production[j];
-                    bool isLast = (j == production.size() - 1);
-                    
-                    if (isLast) {
-                        // If B is the last symbol, add FOLLOW(A) to FOLLOW(B)
-                        int beforeSize = followSets[B].size();
-                        followSets[B].insert(followSets[nonTerminal].begin(), followSets[nonTerminal].end());
-                        if (followSets[B].size() > beforeSize) {
-                            changed = true;
-                        }
-                    } else {
-                        // Get the symbols after B
-                        vector<string> beta(production.begin() + j + 1, production.end());
-                        set<string> firstBeta = computeFirstOfString(beta);
-                        
-                        // Add FIRST(beta) - {epsilon} to FOLLOW(B)
-                        for (const auto& symbol : firstBeta) {
-                            if (symbol != "epsilon") {
-                                if (followSets[B].find(symbol) == followSets[B].end()) {
-                                    followSets[B].insert(symbol);
-                                    changed = true;
-                                }
-                            }
-                        }
-                        
-                        // If epsilon is in FIRST(beta), add FOLLOW(A) to FOLLOW(B)
-                        if (firstBeta.find("epsilon") != firstBeta.end()) {
-                            int beforeSize = followSets[B].size();
-                            followSets[B].insert(followSets[nonTerminal].begin(), followSets[nonTerminal].end());
-                            if (followSets[B].size() > beforeSize) {
-                                changed = true;
-                            }
-                        }
-                    }
-                }
-            }
+    for (int i = count - 1; i >= 0; i--) {
+        firstProduction[i] = min(firstProduction[i], firstProduction[i + 1]);
+    }
+    for (int p = 0; p < productionArena.size(); p++) {
+        const Production& prod = productionArena[p];
+        longest = max(longest, static_cast<size_t>(prod.length));
+        for (int i = prod.length - 1; i >= 0; i--) {
+            if (rhsArena[prod.start + i] != grammar.epsilon) pushArena.push_back(rhsArena[prod.start + i]);
         }
-    } while (changed);
-    
-    // Show the FOLLOW sets
-    cout << "FOLLOW Sets:" << endl;
-    outputFile << "FOLLOW Sets:" << endl;
-    for (const auto& entry : followSets) {
-        cout << "FOLLOW(" << entry.first << ") = { ";
-        outputFile << "FOLLOW(" << entry.first << ") = { ";
-        bool first = true;
-        for (const auto& symbol : entry.second) {
-            if (!first) {
-                cout << ", ";
-                outputFile << ", ";
-            }
-            cout << symbol;
-            outputFile << symbol;
-            first = false;
+        pushStart.push_back(pushArena.size());
+    }
+    maxIdleGrowth = count * longest;
+    pushFrom.resize(productionArena.size());
+    rhsFrom.resize(productionArena.size());
+    for (int p = 0; p < productionArena.size(); p++) {
+        pushFrom[p] = pushArena.data() + pushStart[p];
+        rhsFrom[p] = rhsArena.data() + productionArena[p].start;
+    }
+
+    // Stack depth deriving each non-terminal: the k-th symbol a production
+    // pushes (from the bottom) sits on k others, so depth(A) is the largest
+    // k + depth(X) over A's productions.  A recursive reference counts as
+    // one symbol; only input that actually recurses goes deeper.
+    vector<int> depth(count, 0);                    // 0 = not yet, -1 = in progress
+    struct Frame { Symbol nt; int p, k, best; };
+    vector<Frame> pending;
+    auto enter = [&](Symbol nt) {
+        depth[nt - base] = -1;
+        pending.push_back({nt, firstProduction[nt - base], 0, 1});
+    };
+    if (grammar.startSymbol != NO_SYMBOL && isNonTerminal(grammar.startSymbol)) enter(grammar.startSymbol);
+    while (!pending.empty()) {
+        Frame& f = pending.back();
+        if (f.p == firstProduction[f.nt - base + 1]) {
+            depth[f.nt - base] = f.best;
+            pending.pop_back();
+            continue;
+        }
+        if (pushStart[f.p] + f.k == pushStart[f.p + 1]) {
+            f.p++;  f.k = 0;
+            continue;
         }
-        cout << " }" << endl;
-        outputFile << " }" << endl;
+        Symbol X = pushFrom[f.p][f.k];
+        int d = 1;
+        if (isNonTerminal(X) && depth[X - base] == 0) {
+            enter(X);                               // f is invalid from here
+            continue;
+        }
+        if (isNonTerminal(X) && depth[X - base] > 0) d = depth[X - base];
+        f.best = max(f.best, f.k + d);
+        f.k++;
     }
-    cout << endl;
-    outputFile << endl;
+    stackReserve = 1 + (grammar.startSymbol != NO_SYMBOL && isNonTerminal(grammar.startSymbol)
+                        ? depth[grammar.startSymbol - base] : 1);
+    selectTable();
+}
+
+// Hash-cons every right-hand side, both as written and as pushed, into
+// the symbol table's pool and drop this processor's own copies of them
+size_t CFGProcessor::shareStorage() {
+    if (!grammar.symbols.pool) grammar.symbols.pool = make_shared<GrammarPool>();
+    GrammarPool& pool = *grammar.symbols.pool;
+    size_t bytes = 0;
+    for (Symbol s = 0; s < grammar.symbols.size(); s++) bytes += grammar.symbols.name(s).size();
+    for (int p = 0; p < productionArena.size(); p++) {
+        const int pushed = pushStart[p + 1] - pushStart[p];
+        pushFrom[p] = pool.sequence(pushFrom[p], pushed);
+        rhsFrom[p] = pool.sequence(rhsFrom[p], productionArena[p].length);
+        bytes += (pushed + productionArena[p].length) * sizeof(Symbol);
+    }
+    vector<Symbol>().swap(pushArena);
+    vector<Symbol>().swap(rhsArena);
+    vector<vector<vector<Symbol>>>().swap(grammar.productions);
+    return bytes;
+}
+
+bool parseTableFormat(const string& name, TableFormat& format) {
+    if (name == "auto")   { format = TABLE_AUTO;   return true; }
+    if (name == "dense")  { format = TABLE_DENSE;  return true; }
+    if (name == "packed") { format = TABLE_PACKED; return true; }
+    return false;
+}
+
+// A dense lookup is one load and a packed one two, so packing only pays
+// once the dense table has outgrown the cache and packing at least
+// halves it (the threshold is half of a common 2 MB L2)
+static const size_t PACK_ABOVE_BYTES = 1 << 20;
+
+// Pack the table and decide which form the driver reads
+void CFGProcessor::selectTable() {
+    packedTable.build(parseTable, grammar.symbols.numNonTerminals(), grammar.symbols.numTerminals, NO_PRODUCTION);
+    const size_t dense = parseTable.size() * sizeof(int);
+    if (tableFormat == TABLE_AUTO) usePacked = dense > PACK_ABOVE_BYTES && packedTable.bytes() * 2 <= dense;
+    else usePacked = tableFormat == TABLE_PACKED;
+}
+
+void CFGProcessor::setTableFormat(TableFormat format) {
+    tableFormat = format;
+    if (!parseTable.empty()) selectTable();
+}
+
+TableFootprint CFGProcessor::tableFootprint() const {
+    TableFootprint f;
+    f.denseBytes = parseTable.size() * sizeof(int);
+    f.packedBytes = packedTable.bytes();
+    f.packed = usePacked;
+    return f;
 }
 
 // Build the LL(1) parsing table
 void CFGProcessor::constructParseTable() {
-    parseTable.clear();
+    PhaseTimer timer(metrics, "constructParseTable");
+    productionArena.clear();
+    rhsArena.clear();
+    conflicts.clear();
+    parseTable.assign(grammar.symbols.numNonTerminals() * grammar.symbols.numTerminals, NO_PRODUCTION);
+    vector<bool> predictedByFirst;
     
-    for (const auto& entry : grammar.productions) {
-        string nonTerminal = entry.first;
-        
-        for (int i = 0; i < entry.second.size(); i++) {
-            const vector<string>& production = entry.second[i];
-            
-            // Compute FIRST(α)
-            set<string> firstAlpha = computeFirstOfString(production);
-            
-            for (const auto& terminal : firstAlpha) {
-                if (terminal != "epsilon") {
-                    parseTable[{nonTerminal, terminal}] = production;
-                }
-            }
-            
-            if (firstAlpha.find("epsilon") != firstAlpha.end()) {
-                for (const auto& terminal : followSets[nonTerminal]) {
-                    parseTable[{nonTerminal, terminal}] = production;
-                }
-            }
-        }
+    for (Symbol nonTerminal = grammar.symbols.numTerminals; nonTerminal < grammar.symbols.size(); nonTerminal++) {
+        // Copy the right-hand sides into the arena once; cells hold their index
+        int first = appendProductions(nonTerminal);
+        fillTableRow(nonTerminal, first, predictedByFirst, conflicts);
     }
+    buildDriverTables();
+    if (!reports) return;
     
-    cout << "LL(1) Parsing Table:" << endl;
-    outputFile << "LL(1) Parsing Table:" << endl;
+    output.write("LL(1) Parsing Table:\n");
     
-    set<string> tableTerminals;
-    for (const auto& term : grammar.terminals) {
-        if (term != "epsilon") tableTerminals.insert(term);
+    // Every terminal except epsilon gets a column; ids are already in name order
+    vector<Symbol> tableTerminals;
+    for (Symbol term = 0; term < grammar.symbols.numTerminals; term++) {
+        if (term != grammar.epsilon) tableTerminals.push_back(term);
     }
-    tableTerminals.insert("$"); 
     
     const int colWidth = 15;
+    string border = "+" + string(colWidth, '-') + "+";
+    for (int c = 0; c < tableTerminals.size(); c++) {
+        border += string(colWidth, '-') + "+";
+    }
+    border += '\n';
     
-    cout << "+";
-    outputFile << "+";
-    cout << string(colWidth, '-') << "+";
-    outputFile << string(colWidth, '-') << "+";
-    for (const auto& term : tableTerminals) {
-        cout << string(colWidth, '-') << "+";
-        outputFile << string(colWidth, '-') << "+";
-    }
-    cout << endl;
-    outputFile << endl;
-    
-    cout << "|" << setw(colWidth) << "  " << "|";
-    outputFile << "|" << setw(colWidth) << "  " << "|";
-    for (const auto& term : tableTerminals) {
-        cout << setw(colWidth) << term << "|";
-        outputFile << setw(colWidth) << term << "|";
-    }
-    cout << endl;
-    outputFile << endl;
-    
-    cout << "+";
-    outputFile << "+";
-    cout << string(colWidth, '-') << "+";
-    outputFile << string(colWidth, '-') << "+";
-    for (const auto& term : tableTerminals) {
-        cout << string(colWidth, '-') << "+";
-        outputFile << string(colWidth, '-') << "+";
-    }
-    cout << endl;
-    outputFile << endl;
+    // One row at a time, so a huge table is never held as a whole
+    ostringstream row;
+    row << border;
+    row << "|" << setw(colWidth) << "  " << "|";
+    for (int c = 0; c < tableTerminals.size(); c++) {
+        row << setw(colWidth) << grammar.symbols.name(tableTerminals[c]) << "|";
+    }
+    row << '\n' << border;
+    output.write(row.str());
     
-    for (const auto& nt : grammar.nonTerminals) {
-        cout << "|" << setw(colWidth) << nt << "|";
-        outputFile << "|" << setw(colWidth) << nt << "|";
+    vector<Symbol> order = grammar.nonTerminalsByName();
+    for (int n = 0; n < order.size(); n++) {
+        Symbol nt = order[n];
+        row.str("");
+        row << "|" << setw(colWidth) << grammar.symbols.name(nt) << "|";
         
-        for (const auto& term : tableTerminals) {
+        for (int c = 0; c < tableTerminals.size(); c++) {
             string cellContent = "";
-            if (parseTable.find({nt, term}) != parseTable.end()) {
-                cellContent = nt + " -> ";
-                for (int i = 0; i < parseTable[{nt, term}].size(); i++) {
-                    cellContent += parseTable[{nt, term}][i] + " ";
-                }
+            int cell = tableCell(nt, tableTerminals[c]);
+            if (cell != NO_PRODUCTION) {
+                cellContent = productionText(cell, " -> ");
             }
-            cout << setw(colWidth) << cellContent << "|";
-            outputFile << setw(colWidth) << cellContent << "|";
+            row << setw(colWidth) << cellContent << "|";
+        }
+        row << '\n' << border;
+        output.write(row.str());
+    }
+    
+    // Report every cell that more than one production wanted
+    if (!conflicts.empty()) {
+        output.write("\nLL(1) Conflicts (grammar is not LL(1)):\n");
+        for (int i = 0; i < conflicts.size(); i++) {
+            const TableConflict& c = conflicts[i];
+            string line = "M[" + grammar.symbols.name(c.nonTerminal) + ", " + grammar.symbols.name(c.terminal) +
+                          "]: kept " + productionText(c.kept, " -> ") + "| dropped " + productionText(c.dropped, " -> ");
+            output.write(line + "\n");
+        }
+    }
+}
+
+// Add nt's productions to the arena; returns the index of the first one
+int CFGProcessor::appendProductions(Symbol nt) {
+    int first = productionArena.size();
+    const vector<vector<Symbol>>& rules = grammar.rules(nt);
+    for (int i = 0; i < rules.size(); i++) {
+        productionArena.push_back({nt, static_cast<int>(rhsArena.size()), static_cast<int>(rules[i].size())});
+        rhsArena.insert(rhsArena.end(), rules[i].begin(), rules[i].end());
+    }
+    return first;
+}
+
+// Fill nt's (cleared) table row from its productions, which start at
+// arena index first.  A clash is recorded in found rather than silently
+// overwritten; a FIRST prediction beats an epsilon (FOLLOW) one, so a
+// dangling else binds to the nearest if, and otherwise the earlier
+// production stays.
+void CFGProcessor::fillTableRow(Symbol nt, int first, vector<bool>& predictedByFirst,
+                                vector<TableConflict>& found) {
+    predictedByFirst.assign(grammar.symbols.numTerminals, false);
+    
+    auto fillCell = [&](Symbol terminal, int index, bool viaFirst) {
+        int& cell = tableCell(nt, terminal);
+        if (cell == NO_PRODUCTION) {
+            cell = index;
+            predictedByFirst[terminal] = viaFirst;
+            return;
         }
-        cout << endl;
-        outputFile << endl;
+        if (cell == index) return;
+        
+        bool replace = viaFirst && !predictedByFirst[terminal];
+        found.push_back({nt, terminal, replace ? index : cell, replace ? cell : index});
+        if (replace) {
+            cell = index;
+            predictedByFirst[terminal] = true;
+        }
+    };
+    
+    const vector<vector<Symbol>>& rules = grammar.rules(nt);
+    for (int i = 0; i < rules.size(); i++) {
+        int index = first + i;
+        
+        // Compute FIRST(α)
+        TerminalSet firstAlpha = computeFirstOfString(rules[i]);
         
-        cout << "+";
-        outputFile << "+";
-        cout << string(colWidth, '-') << "+";
-        outputFile << string(colWidth, '-') << "+";
-        for (const auto& term : tableTerminals) {
-            cout << string(colWidth, '-') << "+";
-            outputFile << string(colWidth, '-') << "+";
+        firstAlpha.forEach([&](Symbol terminal) {
+            if (terminal != grammar.epsilon) {
+                fillCell(terminal, index, true);
+            }
+        });
+        
+        if (firstAlpha.contains(grammar.epsilon)) {
+            followOf(nt).forEach([&](Symbol terminal) {
+                fillCell(terminal, index, false);
+            });
         }
-        cout << endl;
-        outputFile << endl;
     }
 }
 
+// Format production p as "LHS<arrow>a b c "
+string CFGProcessor::productionText(int p, const string& arrow) const {
+    const Production& prod = productionArena[p];
+    string text = grammar.symbols.name(prod.lhs) + arrow;
+    for (int i = 0; i < prod.length; i++) {
+        text += grammar.symbols.name(rhsFrom[p][i]) + " ";
+    }
+    return text;
+}
+
 //DISPLAY
-void CFGProcessor::displayResults() {
-    cout << "Original Grammar:" << endl;
-    outputFile << "Original Grammar:" << endl;
+bool CFGProcessor::displayResults() {
+    output.write("Original Grammar:\n");
     displayGrammar(grammar);
     
     performLeftFactoring();
-    eliminateLeftRecursion();
+    if (!eliminateLeftRecursion()) return false;
     computeFirstSets();
     computeFollowSets();
     constructParseTable();
+    return true;
+}
+
+Metrics CFGProcessor::metricsSnapshot(const ParseCounters* running) const {
+    Metrics snapshot = metrics;
+    snapshot.parse.add(mainContext.counters);
+    if (running) snapshot.parse.add(*running);
+    TableFootprint table = tableFootprint();
+    snapshot.denseTableBytes = table.denseBytes;
+    snapshot.packedTableBytes = table.packedBytes;
+    snapshot.tablePacked = table.packed;
+    return snapshot;
+}
+
+// Also arms SIGUSR1, which writes a snapshot between lines
+void CFGProcessor::setMetricsOutput(const string& path, MetricsFormat format) {
+    metricsPath = path;
+    metricsFormat = format;
+    if (!path.empty()) installMetricsSignal();
+}
+
+// Replace the file whole, so a scraper never reads half a snapshot
+bool CFGProcessor::writeMetrics(const ParseCounters* running) const {
+    if (metricsPath.empty()) return false;
+    string tmp = metricsPath + ".tmp";
+    {
+        ofstream out(tmp);
+        out << formatMetrics(metricsSnapshot(running), metricsFormat);
+        if (!out) return false;
+    }
+    return rename(tmp.c_str(), metricsPath.c_str()) == 0;
+}
+
+// Same pipeline without the reports, for runs that only want to parse
+bool CFGProcessor::buildTables() {
+    const bool wasReporting = reports;
+    reports = false;
+    performLeftFactoring();
+    const bool ok = eliminateLeftRecursion();
+    if (ok) {
+        computeFirstSets();
+        computeFollowSets();
+        constructParseTable();
+    }
+    reports = wasReporting;
+    return ok;
 }
 
 // int main(int argc, char* argv[]) {
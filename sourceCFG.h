@@ -11,49 +11,266 @@
 #include <algorithm>
 #include <iomanip>
 #include <stack>
+#include <unordered_map>
+#include <string_view>
+#include <climits>
 
-struct Grammar {
-    std::set<std::string> terminals;
-    std::set<std::string> nonTerminals;
-    std::map<std::string, std::vector<std::vector<std::string>>> productions;
-    std::string startSymbol;
+#include "grammar.h"
+#include "lexer.h"
+#include "lineReader.h"
+#include "metrics.h"
+#include "outputWriter.h"
+#include "packedTable.h"
+#include "parseTree.h"
+#include "symbolStack.h"
+#include "terminalSet.h"
+#include "tokenStream.h"
+#include "trace.h"
+
+// A production in the parse-table arena: its right-hand side is the slice
+// rhsArena[start, start + length)
+struct Production {
+    Symbol lhs;
+    int start;
+    int length;
+};
+
+const int NO_PRODUCTION = -1;
+
+// What the parse driver does with a symbol on top of the stack
+enum StackAction : uint8_t {
+    ACT_MATCH,       // terminal: consume it or report it missing
+    ACT_EXPAND,      // non-terminal: replace it by the table's production
+    ACT_ACCEPT       // the end marker: accept, or restart on leftover input
+};
+
+// Two productions competing for one parse-table cell
+struct TableConflict {
+    Symbol nonTerminal;
+    Symbol terminal;
+    int kept;        // production index left in the cell
+    int dropped;
+};
+
+// A syntax error as the library hands it back (ParseContext::errors)
+struct SyntaxError {
+    int line;
+    int column;                  // 1-based
+    std::string message;
+};
+
+// What parserGen.cpp emits for the parse loop
+enum EmitStyle {
+    EMIT_TABLE,      // constexpr table + one driver loop
+    EMIT_RD          // one recursive-descent function per non-terminal
+};
+
+bool parseEmitStyle(const std::string& name, EmitStyle& style);
+
+// Which form of the parse table the driver reads (the dense one is always kept)
+enum TableFormat {
+    TABLE_AUTO,      // packed once the dense table is big and mostly empty
+    TABLE_DENSE,
+    TABLE_PACKED     // PackedTable (packedTable.h)
+};
+
+bool parseTableFormat(const std::string& name, TableFormat& format);
+
+// Bytes of each parse-table form, and the one in use
+struct TableFootprint {
+    size_t denseBytes = 0;
+    size_t packedBytes = 0;
+    bool packed = false;
+};
+
+// Everything the pipeline derives from one grammar, as stored in the cache
+struct CachedAnalysis {
+    Grammar grammar;                            // after left factoring / recursion elimination
+    std::vector<bool> nullable;
+    std::vector<TerminalSet> firstSets;
+    std::vector<TerminalSet> followSets;
+    std::vector<Production> productionArena;
+    std::vector<Symbol> rhsArena;
+    std::vector<int> parseTable;
+    std::vector<TableConflict> conflicts;
+};
+
+// Reusable per-thread state for the parse driver.  Every worker owns one,
+// so parsing only ever reads the processor itself.
+struct ParseContext {
+    TraceSink* out = nullptr;
+    std::ostream* diag = &std::cerr;            // lexer warnings, internal errors
+    std::vector<Token> tokens;                  // the line being parsed
+    SymbolStack stack;
+
+    // Parse trees: built into treeArena when it is set, rooted at tree
+    Arena* treeArena = nullptr;
+    TreeNode* tree = nullptr;
+    std::vector<TreeNode*> nodes;               // tree node of each stack entry
+    Arena lineArena;                            // per-line trees for --tree, reset every line
+
+    ParseCounters counters;                     // this thread's share of the metrics
+
+    // When set, syntax errors are collected here instead of written to out
+    std::vector<SyntaxError>* errors = nullptr;
 };
 
 class CFGProcessor {
 private:
     Grammar grammar;
-    std::map<std::string, std::set<std::string>> firstSets;
-    std::map<std::string, std::set<std::string>> followSets;
-    std::map<std::pair<std::string, std::string>, std::vector<std::string>> parseTable;
+    std::vector<TerminalSet> firstSets;         // by non-terminal index
+    std::vector<TerminalSet> followSets;        // by non-terminal index
+    std::vector<bool> nullable;                 // by non-terminal index
+    std::vector<Production> productionArena;
+    std::vector<Symbol> rhsArena;
+    std::vector<int> parseTable;                // row-major [non-terminal][terminal]
+    TableFormat tableFormat = TABLE_AUTO;
+    PackedTable packedTable;                    // the same table, comb-packed
+    bool usePacked = false;                     // the driver reads packedTable
+    std::vector<TableConflict> conflicts;
+    std::vector<TerminalSet> syncSets;          // by non-terminal index: FOLLOW + $, where panic mode stops
+    size_t maxIdleGrowth = 0;                   // stack growth one token's expansions can legally reach
+    std::vector<Symbol> pushArena;              // each production's RHS reversed, epsilons dropped
+    std::vector<int> pushStart;                 // by production, plus one: its slice of pushArena
+    std::vector<const Symbol*> pushFrom;        // by production: that slice, in pushArena or the pool
+    std::vector<const Symbol*> rhsFrom;         // by production: its RHS, in rhsArena or the pool
+    std::vector<StackAction> stackActions;      // by symbol, for the driver's dispatch
+    size_t stackReserve = 0;                    // derivation depth of the start symbol, recursion aside
+    Lexer lexer;                                // built once the terminals are known
+    ParseContext mainContext;                   // used by parseString and jobs == 1
+    int jobs = 1;                               // worker threads for parseInputFile
+    bool printTrees = false;                    // show each line's parse tree (--tree)
+    bool wholeFile = false;                     // the input is one sentence, not one per line
+    Metrics metrics;                            // phase times + counters merged from finished work
+    std::string metricsPath;                    // where writeMetrics goes, empty = nowhere
+    MetricsFormat metricsFormat = METRICS_JSON;
+    bool reports = true;                        // print each pipeline stage's result
+    std::string grammarFile;
+    uint64_t grammarHash = 0;                   // content hash keying the cache, 0 until needed
+    std::string errorText;                      // why the last failing call failed
 
-    bool isTerminal(const std::string& symbol);
-    bool isNonTerminal(const std::string& symbol);
-    std::set<std::string> computeFirstOfString(const std::vector<std::string>& symbols);
+    bool isTerminal(Symbol symbol) const { return grammar.symbols.isTerminal(symbol); }
+    bool isNonTerminal(Symbol symbol) const { return grammar.symbols.isNonTerminal(symbol); }
+    TerminalSet& firstOf(Symbol nt) { return firstSets[nt - grammar.symbols.numTerminals]; }
+    TerminalSet& followOf(Symbol nt) { return followSets[nt - grammar.symbols.numTerminals]; }
+    bool isNullable(Symbol nt) const { return nullable[nt - grammar.symbols.numTerminals]; }
+    int& tableCell(Symbol nt, Symbol terminal) {
+        return parseTable[(nt - grammar.symbols.numTerminals) * grammar.symbols.numTerminals + terminal];
+    }
+    int tableCell(Symbol nt, Symbol terminal) const {
+        return parseTable[(nt - grammar.symbols.numTerminals) * grammar.symbols.numTerminals + terminal];
+    }
+    // The parse driver's lookup, from whichever form selectTable picked
+    int predict(Symbol nt, Symbol terminal) const {
+        return usePacked ? packedTable.at(nt - grammar.symbols.numTerminals, terminal) : tableCell(nt, terminal);
+    }
+    void selectTable();
+    void computeNullable(const std::vector<bool>* cone = nullptr);
+    void propagateFirst(const std::vector<bool>* cone);
+    void propagateFollow(const std::vector<bool>* cone, const std::vector<Symbol>* scan);
+    int appendProductions(Symbol nt);
+    void buildDriverTables();
+    void fillTableRow(Symbol nt, int first, std::vector<bool>& predictedByFirst,
+                      std::vector<TableConflict>& found);
+    TerminalSet computeFirstOfString(const std::vector<Symbol>& symbols);
+    void printSets(const std::string& label, const std::vector<TerminalSet>& sets);
+    bool readGrammar(LineReader& file);
+    std::string treeText(const TreeNode* root, std::string_view source) const;
 
     /* ——— NEW helper for pretty-printing ——— */
-    void printTableHeader();
-    void displayStack(std::stack<std::string> s,
-                      const std::string& input,
-                      int position,
-                      const std::string& action);   // <-- extra column
+    void printTableHeader(TraceSink& out) const;
+    void displayStack(const ParseContext& ctx,
+                      const std::string& input,     // the unread tokens
+                      const std::string& action) const;   // <-- extra column
+
+    template <TraceLevel Level>
+    bool runParse(std::string_view input, int lineNumber, ParseContext& ctx) const;
+    template <TraceLevel Level, class Input>        // TokenArray or TokenStream
+    bool drive(Input& in, ParseContext& ctx) const;
+    bool parseStream(LineReader& in, TraceSink& out);
+    bool parseLine(std::string_view line, int lineNumber, ParseContext& ctx) const;
+    int parseInParallel(LineReader& in, TraceSink& out);
+    void pollMetrics() { if (takeMetricsRequest()) writeMetrics(); }
+
+    static uint64_t hashGrammarFile(const std::string& filename);
+    bool readCache(const std::string& cachePath, bool requireFresh, CachedAnalysis& out);
+
+    OutputWriter output;                        // reports and traces: console + output file
+    unsigned consoleSink = 0, fileSink = 0;     // their bits in output
+    TraceSink* trace;                           // where parse traces go
 
 public:
-    std::ofstream outputFile;
 
     CFGProcessor(const std::string& cfgFile, const std::string& outFile);
+    CFGProcessor();                             // no files: loadGrammar, nothing printed
     ~CFGProcessor();
 
+    /* ——— Failures set error() instead of printing or exiting ——— */
+    bool failed() const { return !errorText.empty(); }
+    const std::string& error() const { return errorText; }
+    bool loadGrammar(std::string_view text);    // the grammar file's format, from memory
+    // Intern symbol names into pool (before loadGrammar); shareStorage
+    // then moves the built right-hand sides there too and frees this
+    // processor's copies, after which it can still parse and emit but not
+    // be cached or reanalysed.  Returns the bytes it now refers to.
+    void setPool(std::shared_ptr<GrammarPool> pool) { grammar.symbols.pool = std::move(pool); }
+    size_t shareStorage();
+
     void displayGrammar(const Grammar& g);
     void performLeftFactoring();
-    void eliminateLeftRecursion();
+    bool eliminateLeftRecursion();              // false if the grammar would blow up
     void computeFirstSets();
     void computeFollowSets();
     void constructParseTable();
-    void displayResults();
+    bool displayResults();
+    bool buildTables();                         // displayResults without the output
+    void setReports(bool on) { reports = on; }  // off: the stages above print nothing
+
+    /* ——— Binary cache of everything buildTables computes (grammarCache.cpp) ——— */
+    bool loadCache(const std::string& cachePath);    // false if missing, stale or corrupt
+    bool saveCache(const std::string& cachePath);
+    // Stale cache: rerun the transforms, recompute only what the edit touched (incremental.cpp)
+    bool reanalyze(const std::string& cachePath);
+    size_t conflictCount() const { return conflicts.size(); }
+
+    /* ——— Parse-table layout ——— */
+    void setTableFormat(TableFormat format);    // re-selects if the table is already built
+    TableFootprint tableFootprint() const;
+    int tableLookup(Symbol nt, Symbol terminal) const { return predict(nt, terminal); }
+
+    /* ——— Standalone C++ header for this grammar (parserGen.cpp) ——— */
+    bool emitParser(const std::string& headerPath, EmitStyle style) const;
 
     /* ——— Parsing ——— */
+    TraceSink& traceSink() { return *trace; }
+    void setTraceSink(TraceSink* sink) { trace = sink ? sink : &output; }
+    void setJobs(int n) { jobs = n; }           // 0 = one per hardware thread
     void parseInputFile(const std::string& inputFilename);
     bool parseString(const std::string& input, int lineNumber);
+    void setPrintTrees(bool on) { printTrees = on; }
+    void setWholeFile(bool on) { wholeFile = on; }   // parseInputFile: whole file, streamed
+    // Parse with caller-owned state; any number of threads may do this
+    // at once, each with its own context.  Nothing is traced: syntax
+    // errors go to ctx.errors if set, lexer warnings to ctx.diag.
+    bool parseInto(std::string_view input, int lineNumber, ParseContext& ctx) const;
+    const SymbolTable& symbols() const { return grammar.symbols; }
+    std::string productionText(int p, const std::string& arrow) const;
+
+    /* ——— Report output (outputWriter.h): written in the background ——— */
+    void writeConsole(const std::string& text) { output.write(text, consoleSink); }
+    void writeOutputFile(const std::string& text) { output.write(text, fileSink); }
+    bool flushOutput() { output.flush(); return !output.failed(); }
+
+    /* ——— Metrics (metrics.h) ——— */
+    // running: counts of a parse still in progress, not yet in the totals
+    Metrics metricsSnapshot(const ParseCounters* running = nullptr) const;
+    void setMetricsOutput(const std::string& path, MetricsFormat format);
+    bool writeMetrics(const ParseCounters* running = nullptr) const;   // snapshot to metricsPath
+
+    // Parse one line into a concrete syntax tree allocated from arena.  The
+    // caller resets the arena, so one arena can hold a whole batch of trees.
+    // root is set even when the line has errors (missing pieces stay empty).
+    bool parseTree(std::string_view input, int lineNumber, Arena& arena, TreeNode*& root);
     std::string getNextToken(const std::string& input, int& position);
 };
 
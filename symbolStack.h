@@ -0,0 +1,60 @@
+#ifndef SYMBOL_STACK_H
+#define SYMBOL_STACK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+#include "grammar.h"
+
+/* ——— Parse stack ———
+   A contiguous array of symbol ids and a top index.  Expanding a
+   production is one memcpy of its precomputed reversed right-hand side;
+   unlike vector::resize nothing is zero-filled first.  The driver
+   reserves the grammar's derivation depth up front, so only input that
+   recurses deeper than that ever makes the array grow (by doubling).  */
+class SymbolStack {
+public:
+    SymbolStack() {}
+
+    SymbolStack(const SymbolStack&) = delete;
+    SymbolStack& operator=(const SymbolStack&) = delete;
+    SymbolStack(SymbolStack&&) = default;
+    SymbolStack& operator=(SymbolStack&&) = default;
+
+    void reserve(size_t n) { if (n > capacity) grow(n); }
+    void clear() { top = 0; }
+    bool empty() const { return top == 0; }
+    size_t size() const { return top; }
+    Symbol back() const { return data[top - 1]; }
+    Symbol operator[](size_t i) const { return data[i]; }
+
+    void pop_back() { top--; }
+    void truncate(size_t n) { top = n; }        // n <= size()
+    void push_back(Symbol s) {
+        if (top == capacity) grow(top + 1);
+        data[top++] = s;
+    }
+    // symbols[n-1] ends up on top
+    void push(const Symbol* symbols, size_t n) {
+        if (top + n > capacity) grow(top + n);
+        std::memcpy(data.get() + top, symbols, n * sizeof(Symbol));
+        top += n;
+    }
+
+private:
+    void grow(size_t need) {
+        size_t n = std::max(need, capacity * 2);
+        std::unique_ptr<Symbol[]> bigger(new Symbol[n]);
+        if (top) std::memcpy(bigger.get(), data.get(), top * sizeof(Symbol));
+        data = std::move(bigger);
+        capacity = n;
+    }
+
+    std::unique_ptr<Symbol[]> data;
+    size_t top = 0;
+    size_t capacity = 0;
+};
+
+#endif   // SYMBOL_STACK_H
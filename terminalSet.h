@@ -0,0 +1,65 @@
+#ifndef TERMINAL_SET_H
+#define TERMINAL_SET_H
+
+#include <cstdint>
+#include <vector>
+
+/* ——— Fixed-width bitset over terminal ids ———
+   Used for FIRST/FOLLOW sets.  Every set in one analysis has the same
+   width (the grammar's terminal count), so unions are word-wise ORs and
+   iteration visits members in id order, i.e. alphabetically.           */
+class TerminalSet {
+public:
+    TerminalSet() {}
+    explicit TerminalSet(int width) : words((width + 63) / 64, 0) {}
+
+    void insert(int t)         { words[t >> 6] |= uint64_t(1) << (t & 63); }
+    void erase(int t)          { words[t >> 6] &= ~(uint64_t(1) << (t & 63)); }
+    bool contains(int t) const { return (words[t >> 6] >> (t & 63)) & 1; }
+
+    bool empty() const {
+        for (size_t w = 0; w < words.size(); w++)
+            if (words[w]) return false;
+        return true;
+    }
+
+    void clear() {
+        for (size_t w = 0; w < words.size(); w++) words[w] = 0;
+    }
+
+    // this |= other, minus one excluded member (e.g. epsilon); true if it grew
+    bool unionWith(const TerminalSet& other, int except = -1) {
+        uint64_t grew = 0;
+        for (size_t w = 0; w < words.size(); w++) {
+            uint64_t add = other.words[w];
+            if (except >= 0 && static_cast<size_t>(except >> 6) == w)
+                add &= ~(uint64_t(1) << (except & 63));
+            grew |= add & ~words[w];
+            words[w] |= add;
+        }
+        return grew != 0;
+    }
+
+    bool operator==(const TerminalSet& other) const { return words == other.words; }
+    bool operator!=(const TerminalSet& other) const { return words != other.words; }
+
+    // Calls f(t) for every member in ascending id order
+    template <class F>
+    void forEach(F f) const {
+        for (size_t w = 0; w < words.size(); w++) {
+            uint64_t bits = words[w];
+            while (bits) {
+                f(static_cast<int>(w * 64 + __builtin_ctzll(bits)));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    const std::vector<uint64_t>& raw() const { return words; }
+    std::vector<uint64_t>& raw() { return words; }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+#endif   // TERMINAL_SET_H
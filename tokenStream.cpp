@@ -0,0 +1,62 @@
+#include "tokenStream.h"
+
+using namespace std;
+
+
+// The tokens after the lookahead, then "$"
+string TokenArray::rest(const Lexer& lexer) const {
+    string out;
+    for (size_t i = cur + 1; i + 1 < tokens.size(); i++) {
+        out += lexer.text(tokens[i], text);
+        out += ' ';
+    }
+    return out + "$";
+}
+
+TokenStream::TokenStream(LineReader& reader, const Lexer& lexer, vector<Token>& buffer, ostream& diag)
+    : reader(reader), lexer(lexer), tokens(buffer), diag(diag) {
+    nextLine();
+}
+
+void TokenStream::advance() {
+    if (atEnd) return;
+    if (++cur == tokens.size()) nextLine();
+}
+
+// Load the next line that has any tokens, or settle on the end marker,
+// placed just after the last line
+void TokenStream::nextLine() {
+    string_view line;
+    while (reader.nextLine(line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') continue;
+        lexer.tokenize(line, tokens, diag);
+        tokens.pop_back();                  // the line's end marker
+        if (tokens.empty()) continue;
+        text = line;
+        tokenLine = lineNumber;
+        cur = 0;
+        count += tokens.size();
+        return;
+    }
+
+    uint32_t end = static_cast<uint32_t>(text.size());
+    lexer.tokenize(string_view(), tokens, diag);
+    tokens[0].offset = end;
+    text = string_view();
+    if (!tokenLine) tokenLine = 1;          // empty input
+    cur = 0;
+    count++;
+    atEnd = true;
+}
+
+// The rest of the current line; later lines aren't read ahead
+string TokenStream::rest(const Lexer& lexer) const {
+    if (atEnd) return "$";
+    string out;
+    for (size_t i = cur + 1; i < tokens.size(); i++) {
+        out += lexer.text(tokens[i], text);
+        out += ' ';
+    }
+    return out + "...";
+}
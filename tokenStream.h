@@ -0,0 +1,75 @@
+#ifndef TOKEN_STREAM_H
+#define TOKEN_STREAM_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexer.h"
+#include "lineReader.h"
+
+/* ——— Token sources for the parse driver ———
+   The driver only sees the current token, so the same loop parses one
+   pre-lexed line (TokenArray) or a whole file (TokenStream).  Both offer:
+
+     token()    the lookahead; the end marker once the input is used up
+     advance()  move past it (a no-op at the end marker)
+     line()     line number of the lookahead, for diagnostics
+     source()   the text token().offset is relative to
+     rest()     the unread input, for the trace's INPUT column
+     lexed(), lines()   totals for the metrics                         */
+
+class TokenArray {
+public:
+    TokenArray(const std::vector<Token>& tokens, std::string_view text, int lineNumber)
+        : tokens(tokens), text(text), lineNumber(lineNumber) {}
+
+    const Token& token() const { return tokens[cur]; }
+    void advance() { if (cur + 1 < tokens.size()) ++cur; }
+    int line() const { return lineNumber; }
+    std::string_view source() const { return text; }
+    std::string rest(const Lexer& lexer) const;
+    uint64_t lexed() const { return tokens.size(); }
+    uint64_t lines() const { return 1; }
+
+private:
+    const std::vector<Token>& tokens;
+    std::string_view text;
+    int lineNumber;
+    size_t cur = 0;
+};
+
+/* Lexes a file one line at a time and hands out its tokens as a single
+   stream: only the current line's tokens are held, so memory depends on
+   the longest line, never on the file.  Blank lines and '#' comment
+   lines are skipped, as in the line-by-line mode.                      */
+class TokenStream {
+public:
+    TokenStream(LineReader& reader, const Lexer& lexer, std::vector<Token>& buffer, std::ostream& diag);
+
+    const Token& token() const { return tokens[cur]; }
+    void advance();
+    int line() const { return tokenLine; }
+    std::string_view source() const { return text; }
+    std::string rest(const Lexer& lexer) const;
+    uint64_t lexed() const { return count; }
+    uint64_t lines() const { return lineNumber; }
+
+private:
+    void nextLine();
+
+    LineReader& reader;
+    const Lexer& lexer;
+    std::vector<Token>& tokens;     // the current line's, without its end marker
+    std::ostream& diag;
+    std::string_view text;
+    int lineNumber = 0;             // lines read so far
+    int tokenLine = 0;              // the line tokens came from
+    size_t cur = 0;
+    uint64_t count = 0;
+    bool atEnd = false;
+};
+
+#endif   // TOKEN_STREAM_H
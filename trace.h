@@ -0,0 +1,67 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <ostream>
+#include <string>
+
+/* ——— How much of a parse gets reported ———
+   Each level includes everything below it.                            */
+enum TraceLevel {
+    TRACE_NONE,      // nothing; callers only look at the return value
+    TRACE_ERRORS,    // syntax errors, give-ups and the final error count
+    TRACE_SUMMARY,   // + per-line heading, source and result
+    TRACE_FULL       // + the STACK | INPUT | ACTION step table
+};
+
+bool parseTraceLevel(const std::string& name, TraceLevel& level);
+
+/* ——— Where parse traces go ———
+   The parse driver is instantiated once per level, so anything above the
+   sink's level is compiled out of the loop rather than formatted and
+   thrown away.                                                         */
+class TraceSink {
+public:
+    explicit TraceSink(TraceLevel level = TRACE_FULL) : level(level) {}
+    virtual ~TraceSink() {}
+
+    virtual void write(const std::string& text) = 0;
+    // A whole rendered buffer; a sink that queues output may take its storage
+    virtual void writeBuffer(std::string& text) { write(text); }
+
+    TraceLevel level;
+};
+
+// The console, optionally mirrored to a second stream (the output file)
+class StreamTrace : public TraceSink {
+public:
+    StreamTrace(TraceLevel level, std::ostream* primary, std::ostream* mirror = nullptr)
+        : TraceSink(level), primary(primary), mirror(mirror) {}
+
+    void write(const std::string& text) override {
+        if (primary) *primary << text;
+        if (mirror) *mirror << text;
+    }
+
+    std::ostream* primary;
+    std::ostream* mirror;
+};
+
+// Collects the trace in memory
+class StringTrace : public TraceSink {
+public:
+    explicit StringTrace(TraceLevel level) : TraceSink(level) {}
+
+    void write(const std::string& text) override { buffer += text; }
+
+    std::string buffer;
+};
+
+// Throws the trace away
+class NullTrace : public TraceSink {
+public:
+    NullTrace() : TraceSink(TRACE_NONE) {}
+
+    void write(const std::string&) override {}
+};
+
+#endif   // TRACE_H